@@ -0,0 +1,402 @@
+#include <fcntl.h>
+#include <linux/input.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gamepad.h"
+#include "internal.h"
+#include "trigger.h"
+
+// Microbenchmarks for the translation hot path. Nothing here touches
+// /dev/uinput: emission goes to /dev/null so the numbers include the write(2)
+// per input_event that a real run pays, without needing a device or X11.
+
+#define MAX_TOKENS 4096
+#define DEFAULT_ROUNDS 200
+#define TRIGGER_LINE "C-x h e l l o <return>\n"
+#define TRIGGER_LINE_KEYS 7
+#define GAMEPAD_FRAMES_PER_ROUND 1000
+
+// Both sticks and triggers moving at once, the busiest frame a curve set makes.
+static const char *gamepad_curves[] = {
+  "x:sine:-32768:32767:250", "y:sine:-32768:32767:250:62",
+  "rx:sine:-32768:32767:400", "ry:sine:-32768:32767:400:100",
+  "lt:sine:0:255:300", "rt:sine:0:255:300:150",
+};
+
+static const char *source_corpus =
+  "static int is_event_device(const struct dirent *dent) {\n"
+  "  return strncmp(\"event\", dent->d_name, 5) == 0;\n"
+  "}\n"
+  "for (int i = 0; i < ndev; i++) {\n"
+  "  if (list[i].use == IsXKeyboard && flags & ~0x1f) {\n"
+  "    total += (a[i] * 3) % 7 - b[i] / 2; // [done]\n"
+  "  }\n"
+  "}\n";
+
+static const char *prose_corpus =
+  "Youinput is a linux command line utility for typing input. What makes\n"
+  "it different than many other tools is that it inputs the arguments\n"
+  "given without interruption from X11 keybindings. It accepts the emacs\n"
+  "kbd syntax for key combinations, which looks like the following!\n";
+
+static const char *modifier_corpus[] = {
+  "C-x", "C-f", "C-S-a", "M-x", "M-<f4>", "s-<left>", "s-<right>",
+  "C-M-<delete>", "C-S-M-s-z", "S-<tab>", "C-<return>", "M-S-<up>",
+  "C-c", "C-v", "C-<pagedown>", "s-S-<f12>", "C-M-t", "S-h",
+};
+
+static const char *special_corpus[] = {
+  "<space>", "<esc>", "<tab>", "<return>", "<enter>", "<ret>", "<ctrl>",
+  "<control>", "<shift>", "<alt>", "<capslock>", "<f1>", "<f2>", "<f3>",
+  "<f4>", "<f5>", "<f6>", "<f7>", "<f8>", "<f9>", "<f10>", "<f11>", "<f12>",
+  "<f13>", "<f14>", "<f15>", "<f16>", "<f17>", "<f18>", "<f19>", "<f20>",
+  "<up>", "<down>", "<left>", "<right>", "<rightctrl>", "<kpasterisk>",
+  "<leftalt>", "<numlock>", "<scrolllock>", "<kp7>", "<kp8>", "<kp9>",
+  "<kpminus>", "<kp4>", "<kp5>", "<kp6>", "<kpplus>", "<kp1>", "<kp2>",
+  "<kp3>", "<kp0>", "<kpdot>", "<zenkakuhankaku>", "<102nd>", "<ro>",
+  "<katakana>", "<hiragana>", "<henkan>", "<katakanahiragana>", "<muhenkan>",
+  "<kpjpcomma>", "<kpenter>", "<kpslash>", "<sysrq>", "<rightalt>",
+  "<linefeed>", "<home>", "<pageup>", "<end>", "<pagedown>", "<insert>",
+  "<delete>", "<macro>", "<mute>", "<volumedown>", "<volumeup>", "<power>",
+  "<kpequal>", "<kpplusminus>", "<pause>", "<scale>", "<kpcomma>",
+  "<hangeul>", "<hanguel>", "<hanja>", "<yen>", "<leftmeta>", "<rightmeta>",
+  "<compose>", "<stop>", "<again>", "<props>", "<undo>", "<front>", "<copy>",
+  "<open>", "<paste>", "<find>", "<cut>", "<help>", "<menu>", "<calc>",
+  "<setup>", "<sleep>", "<wakeup>", "<file>", "<sendfile>", "<deletefile>",
+  "<xfer>", "<prog1>", "<prog2>", "<www>", "<msdos>", "<coffee>",
+  "<screenlock>", "<rotate_display>", "<direction>", "<cyclewindows>",
+  "<mail>", "<bookmarks>", "<computer>", "<back>", "<forward>", "<closecd>",
+  "<ejectcd>", "<ejectclosecd>", "<nextsong>", "<playpause>",
+  "<previoussong>", "<stopcd>", "<record>", "<rewind>", "<phone>", "<iso>",
+  "<config>", "<homepage>", "<refresh>", "<exit>", "<move>", "<edit>",
+  "<scrollup>", "<scrolldown>", "<kpleftparen>", "<kprightparen>", "<new>",
+  "<redo>", "<playcd>", "<pausecd>", "<prog3>", "<prog4>", "<dashboard>",
+  "<suspend>", "<close>", "<play>", "<fastforward>", "<bassboost>",
+  "<print>", "<hp>", "<camera>", "<sound>", "<question>", "<email>",
+  "<chat>", "<search>", "<connect>", "<finance>", "<sport>", "<shop>",
+  "<alterase>", "<cancel>", "<brightnessdown>", "<brightnessup>", "<media>",
+  "<switchvideomode>", "<kbdillumtoggle>", "<kbdillumdown>", "<kbdillumup>",
+  "<send>", "<reply>", "<forwardmail>", "<save>", "<documents>",
+  "<battery>", "<bluetooth>", "<wlan>", "<uwb>", "<unknown>",
+  "<video_next>", "<video_prev>", "<brightness_cycle>", "<brightness_auto>",
+  "<brightness_zero>", "<display_off>", "<wwan>", "<wimax>", "<rfkill>",
+  "<micmute>",
+};
+
+#define NELEMS(a) (sizeof(a) / sizeof((a)[0]))
+
+struct corpus {
+  const char *name;
+  char *tokens[MAX_TOKENS];
+  int ntokens;
+};
+
+typedef struct corpus corpus_t;
+
+// Every heap allocation in the process goes through these so the steady state
+// emission path can be checked for allocations. glibc exports the __libc_*
+// entry points for exactly this kind of interposition. They have to be
+// exported themselves despite -fvisibility=hidden, or calls made inside libc
+// (strdup, fopen, stdio buffers) would never reach them.
+extern void *__libc_malloc(size_t size);
+extern void *__libc_calloc(size_t nmemb, size_t size);
+extern void *__libc_realloc(void *ptr, size_t size);
+
+static volatile long allocations = 0;
+
+__attribute__((visibility("default")))
+void *malloc(size_t size) {
+  allocations++;
+  return __libc_malloc(size);
+}
+
+__attribute__((visibility("default")))
+void *calloc(size_t nmemb, size_t size) {
+  allocations++;
+  return __libc_calloc(nmemb, size);
+}
+
+__attribute__((visibility("default")))
+void *realloc(void *ptr, size_t size) {
+  allocations++;
+  return __libc_realloc(ptr, size);
+}
+
+static char char_pool[MAX_TOKENS][2];
+static int char_pool_used = 0;
+static volatile int sink;
+
+// Splits text into the per-character arguments a shell caller would pass,
+// mapping newlines onto <return> the same way youinput_send_text() does.
+static void corpus_from_text(corpus_t *c, const char *name, const char *text) {
+  c->name = name;
+  c->ntokens = 0;
+  for (const char *p = text; *p && c->ntokens < MAX_TOKENS; p++) {
+    if (*p == '\n') {
+      c->tokens[c->ntokens++] = "<return>";
+      continue;
+    }
+    char *tok = char_pool[char_pool_used++];
+    tok[0] = *p;
+    tok[1] = '\0';
+    c->tokens[c->ntokens++] = tok;
+  }
+}
+
+static void corpus_from_list(corpus_t *c, const char *name,
+                             const char **list, int n) {
+  c->name = name;
+  c->ntokens = 0;
+  for (int i = 0; i < n && c->ntokens < MAX_TOKENS; i++) {
+    c->tokens[c->ntokens++] = (char *) list[i];
+  }
+}
+
+static double now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1e9 + ts.tv_nsec;
+}
+
+static void report(const char *what, const char *corpus, double ns, long keys) {
+  double per_key = ns / keys;
+  printf("%-20s %-10s %10.1f ns/key %14.0f keys/sec\n",
+         what, corpus, per_key, 1e9 / per_key);
+}
+
+static void bench_parse_special_code(corpus_t *c, int rounds) {
+  double start = now_ns();
+  for (int r = 0; r < rounds; r++) {
+    for (int i = 0; i < c->ntokens; i++) {
+      sink += parse_special_code(c->tokens[i]);
+    }
+  }
+  report("parse_special_code", c->name, now_ns() - start,
+         (long) rounds * c->ntokens);
+}
+
+static void bench_meta_codes(corpus_t *c, int rounds) {
+  double start = now_ns();
+  for (int r = 0; r < rounds; r++) {
+    for (int i = 0; i < c->ntokens; i++) {
+      char *remaining = c->tokens[i];
+      control_set_t cset = meta_codes(&remaining);
+      sink += cset.ctrl + cset.shift + cset.meta + cset.alt;
+    }
+  }
+  report("meta_codes", c->name, now_ns() - start,
+         (long) rounds * c->ntokens);
+}
+
+static void bench_emit_cmd(int fd, corpus_t *c, int rounds) {
+  double start = now_ns();
+  for (int r = 0; r < rounds; r++) {
+    for (int i = 0; i < c->ntokens; i++) {
+      emit_cmd(fd, c->tokens[i]);
+    }
+  }
+  report("emit_cmd", c->name, now_ns() - start,
+         (long) rounds * c->ntokens);
+}
+
+static void emit_line(void *ctx, char *line) {
+  int fd = *(int *) ctx;
+  char *save;
+
+  for (char *cmd = strtok_r(line, " ", &save); cmd != NULL;
+       cmd = strtok_r(NULL, " ", &save)) {
+    emit_cmd(fd, cmd);
+  }
+}
+
+// Trigger to injection: a line written to a pipe, picked up through epoll,
+// parsed and emitted. Fails if the steady state allocates.
+static int bench_trigger(int fd, int rounds) {
+  trigger_t trigger;
+  int p[2];
+
+  if (pipe2(p, O_NONBLOCK | O_CLOEXEC) == -1 || trigger_init(&trigger, p[0]) == -1) {
+    perror("trigger setup");
+    return -1;
+  }
+
+  // first line warms up, then every round must be allocation free
+  (void) write(p[1], TRIGGER_LINE, strlen(TRIGGER_LINE));
+  trigger_poll(&trigger, emit_line, &fd, -1);
+
+  long before = allocations;
+  double start = now_ns();
+  for (int r = 0; r < rounds; r++) {
+    (void) write(p[1], TRIGGER_LINE, strlen(TRIGGER_LINE));
+    trigger_poll(&trigger, emit_line, &fd, -1);
+  }
+  double elapsed = now_ns() - start;
+  long count = allocations - before;
+
+  report("trigger", "line", elapsed, (long) rounds * TRIGGER_LINE_KEYS);
+  printf("%-20s %-10s %10.1f us/line, %ld allocations\n", "trigger", "line",
+         elapsed / rounds / 1e3, count);
+
+  close(p[1]);
+  trigger_close(&trigger);
+  if (count != 0) {
+    fprintf(stderr, "trigger path allocated on the heap\n");
+    return -1;
+  }
+  return 0;
+}
+
+// One frame per simulated millisecond, as youinput_pad_run() does at 1kHz.
+// Fails if the tick allocates.
+static int bench_gamepad(int fd, int rounds) {
+  static youinput_pad_t pad;
+
+  for (size_t i = 0; i < NELEMS(gamepad_curves); i++) {
+    if (youinput_pad_add_curve(&pad, gamepad_curves[i]) < 0)
+      return -1;
+  }
+  youinput_pad_tick(&pad, fd, 0);
+
+  long frames = (long) rounds * GAMEPAD_FRAMES_PER_ROUND;
+  long before = allocations;
+  uint64_t events = pad.events;
+  double start = now_ns();
+  for (long f = 1; f <= frames; f++) {
+    youinput_pad_tick(&pad, fd, f);
+  }
+  double elapsed = now_ns() - start;
+  long count = allocations - before;
+
+  printf("%-20s %-10s %10.1f ns/frame %12.1f events/frame, %ld allocations\n",
+         "youinput_pad_tick", "sticks", elapsed / frames,
+         (double) (pad.events - events) / frames, count);
+  if (count != 0) {
+    fprintf(stderr, "youinput_pad_tick allocated on the heap\n");
+    return -1;
+  }
+  return 0;
+}
+
+// The per-key path youinput_emit() takes: drain LED updates, compensate for
+// the lock state, emit, track our own lock keys. A pipe stands in for the
+// uinput fd, with a Caps Lock LED change queued before every corpus so the
+// update and forwarding branches run too. Fails if any of it allocates.
+static int bench_locks(int fd, corpus_t **corpora, int n, int rounds) {
+  struct input_event led[2];
+  lock_state_t locks = { false, true };
+  int p[2];
+  long keys = 0;
+
+  if (pipe2(p, O_NONBLOCK | O_CLOEXEC) == -1) {
+    perror("lock pipe");
+    return -1;
+  }
+  memset(led, 0, sizeof(led));
+  led[0].type = EV_LED;
+  led[0].code = LED_CAPSL;
+  led[1].type = EV_SYN;
+  led[1].code = SYN_REPORT;
+
+  long before = allocations;
+  double start = now_ns();
+  for (int r = 0; r < rounds; r++) {
+    for (int c = 0; c < n; c++) {
+      led[0].value = (r + c) % 2;
+      (void) write(p[1], led, sizeof(led));
+      for (int i = 0; i < corpora[c]->ntokens; i++) {
+        control_set_t cset;
+        int code = parse_cmd(corpora[c]->tokens[i], &cset);
+        if (code <= 0)
+          continue;
+        read_locks(p[0], &locks, fd);
+        emit_combo(fd, compensate_locks(cset, code, locks), code);
+        track_locks(code, &locks);
+      }
+      keys += corpora[c]->ntokens;
+    }
+  }
+  double elapsed = now_ns() - start;
+  long count = allocations - before;
+
+  report("locks+emit_combo", "all", elapsed, keys);
+  printf("%-20s %-10s %10ld allocations over %ld keys\n",
+         "locks+emit_combo", "all", count, keys);
+  close(p[0]);
+  close(p[1]);
+  if (count != 0) {
+    fprintf(stderr, "lock handling allocated on the heap\n");
+    return -1;
+  }
+  return 0;
+}
+
+// Runs every corpus through emit_cmd() and fails if any of it touched the heap.
+// Long running callers loop on this path, so it has to stay allocation free.
+static int check_emit_allocations(int fd, corpus_t **corpora, int n) {
+  long keys = 0;
+  long before = allocations;
+  for (int c = 0; c < n; c++) {
+    for (int i = 0; i < corpora[c]->ntokens; i++) {
+      emit_cmd(fd, corpora[c]->tokens[i]);
+    }
+    keys += corpora[c]->ntokens;
+  }
+  long count = allocations - before;
+
+  printf("%-20s %-10s %10ld allocations over %ld keys\n",
+         "emit_cmd", "all", count, keys);
+  if (count != 0) {
+    fprintf(stderr, "emit_cmd allocated on the heap\n");
+    return -1;
+  }
+  return 0;
+}
+
+int main(int argc, char **argv) {
+  static corpus_t source, prose, modifiers, special;
+  int rounds = DEFAULT_ROUNDS;
+
+  if (argc > 1) {
+    rounds = atoi(argv[1]);
+    if (rounds <= 0) {
+      fprintf(stderr, "usage: %s [rounds]\n", argv[0]);
+      return 1;
+    }
+  }
+
+  int fd = open("/dev/null", O_WRONLY);
+  if (fd == -1) {
+    perror("/dev/null failed to open");
+    return 1;
+  }
+
+  corpus_from_text(&source, "source", source_corpus);
+  corpus_from_text(&prose, "prose", prose_corpus);
+  corpus_from_list(&modifiers, "modifiers", modifier_corpus,
+                   NELEMS(modifier_corpus));
+  corpus_from_list(&special, "special", special_corpus,
+                   NELEMS(special_corpus));
+
+  bench_parse_special_code(&special, rounds);
+  bench_meta_codes(&modifiers, rounds);
+  bench_emit_cmd(fd, &source, rounds);
+  bench_emit_cmd(fd, &prose, rounds);
+  bench_emit_cmd(fd, &modifiers, rounds);
+  bench_emit_cmd(fd, &special, rounds);
+
+  corpus_t *all[] = { &source, &prose, &modifiers, &special };
+  int rc = check_emit_allocations(fd, all, NELEMS(all));
+  if (bench_locks(fd, all, NELEMS(all), rounds) < 0)
+    rc = -1;
+  if (bench_trigger(fd, rounds) < 0)
+    rc = -1;
+  if (bench_gamepad(fd, rounds) < 0)
+    rc = -1;
+
+  close(fd);
+  return rc == 0 ? 0 : 1;
+}
@@ -0,0 +1,256 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "internal.h"
+#include "script.h"
+
+// Behaviour checks for the script compiler and interpreter. Like the bench,
+// nothing here needs a device: keys are recorded instead of emitted. Scripts
+// are written to a scratch directory under /tmp, removed again on success.
+
+#define MAX_KEYS 256
+
+struct recording {
+  int codes[MAX_KEYS];
+  control_set_t csets[MAX_KEYS];
+  int n;
+};
+
+static char dir[] = "/tmp/youinput-check-XXXXXX";
+static int failures = 0;
+
+static int record(void *ctx, control_set_t cset, int code) {
+  struct recording *r = ctx;
+  if (r->n < MAX_KEYS) {
+    r->codes[r->n] = code;
+    r->csets[r->n] = cset;
+    r->n++;
+  }
+  return 1;
+}
+
+static void path_of(char *buf, size_t len, const char *name) {
+  snprintf(buf, len, "%s/%s", dir, name);
+}
+
+static void write_file(const char *name, const char *text) {
+  char path[256];
+  path_of(path, sizeof(path), name);
+  FILE *f = fopen(path, "w");
+  if (f == NULL) {
+    perror(path);
+    exit(1);
+  }
+  fputs(text, f);
+  fclose(f);
+}
+
+static void report(const char *what, bool ok) {
+  printf("%-40s %s\n", what, ok ? "ok" : "FAIL");
+  if (!ok)
+    failures++;
+}
+
+static bool same_cset(control_set_t a, control_set_t b) {
+  return a.ctrl == b.ctrl && a.shift == b.shift && a.meta == b.meta
+    && a.alt == b.alt;
+}
+
+// True if running the script types exactly the blank separated commands in
+// expected.
+static bool types(const char *name, bool use_cache, const char *expected) {
+  char path[256];
+  char buf[512];
+  char *save;
+  script_t s;
+  struct recording r;
+  int i = 0;
+
+  path_of(path, sizeof(path), name);
+  if (script_load(&s, path, use_cache) < 0)
+    return false;
+  memset(&r, 0, sizeof(r));
+  script_run(&s, record, &r);
+  script_free(&s);
+
+  snprintf(buf, sizeof(buf), "%s", expected);
+  for (char *cmd = strtok_r(buf, " ", &save); cmd != NULL;
+       cmd = strtok_r(NULL, " ", &save), i++) {
+    control_set_t cset;
+    int code = parse_cmd(cmd, &cset);
+    if (i >= r.n || r.codes[i] != code || !same_cset(r.csets[i], cset))
+      return false;
+  }
+  return i == r.n;
+}
+
+static bool rejected(const char *name) {
+  char path[256];
+  script_t s;
+
+  path_of(path, sizeof(path), name);
+  // the error message is expected, keep it out of the report
+  fflush(stderr);
+  int saved = dup(STDERR_FILENO);
+  int null = open("/dev/null", O_WRONLY);
+  dup2(null, STDERR_FILENO);
+  close(null);
+  int rc = script_load(&s, path, false);
+  fflush(stderr);
+  dup2(saved, STDERR_FILENO);
+  close(saved);
+  if (rc == 0)
+    script_free(&s);
+  return rc < 0;
+}
+
+static void check_comments(void) {
+  write_file("comments.yi",
+             "# a whole line\n"
+             "key C-x C-f  # trailing\n"
+             "text hi   # trailing, blanks before it dropped\n"
+             "key #\n"
+             "text a #5\n");
+  report("comments", types("comments.yi", false,
+                           "C-x C-f h i # a <space> # 5"));
+}
+
+static void check_loops(void) {
+  write_file("loops.yi",
+             "loop 2\n key a\nend\n"
+             "loop 0\n key b\nend\n"
+             "set n -1\nloop $n\n key c\nend\n"
+             "set n 3\nloop $n\n loop 2\n  key d\n end\nend\n");
+  report("loop counts and nesting", types("loops.yi", false,
+                                          "a a d d d d d d"));
+  write_file("negative.yi", "loop -1\nend\n");
+  report("negative literal loop rejected", rejected("negative.yi"));
+  write_file("unbalanced.yi", "loop 2\nkey a\n");
+  report("loop without end rejected", rejected("unbalanced.yi"));
+  write_file("stray.yi", "end\n");
+  report("end without loop rejected", rejected("stray.yi"));
+}
+
+static void check_jumps(void) {
+  write_file("jumps.yi",
+             "set n 3\n"
+             "label top\n"
+             "key a\n"
+             "add n -1\n"
+             "jnz n top\n"
+             "jz n skip\n"
+             "key b\n"
+             "label skip\n"
+             "goto end\n"
+             "key c\n"
+             "label end\n"
+             "key d\n");
+  report("labels, jz, jnz and goto", types("jumps.yi", false, "a a a d"));
+  write_file("unknown.yi", "goto nowhere\n");
+  report("unknown label rejected", rejected("unknown.yi"));
+  write_file("duplicate.yi", "label x\nlabel x\n");
+  report("duplicate label rejected", rejected("duplicate.yi"));
+}
+
+static void check_syntax(void) {
+  write_file("extra.yi", "wait 10 20\n");
+  report("extra words rejected", rejected("extra.yi"));
+  write_file("badkey.yi", "key <nosuchkey>\n");
+  report("bad key rejected", rejected("badkey.yi"));
+  write_file("unknownop.yi", "frobnicate\n");
+  report("unknown statement rejected", rejected("unknownop.yi"));
+}
+
+static void check_includes(void) {
+  write_file("inner.yi", "key b\n");
+  write_file("outer.yi", "key a\ninclude inner.yi\nkey c\n");
+  report("include", types("outer.yi", false, "a b c"));
+  write_file("self.yi", "include self.yi\n");
+  report("include loop rejected", rejected("self.yi"));
+}
+
+// Overwrites the first instruction of a cached script, which starts right
+// after the header and dependency table.
+static bool patch_cache(const char *name, const struct script_insn *insn) {
+  char path[256];
+  char cpath[300];
+  script_t s;
+
+  path_of(path, sizeof(path), name);
+  snprintf(cpath, sizeof(cpath), "%s%s", path, SCRIPT_CACHE_SUFFIX);
+  if (script_load(&s, path, false) < 0)
+    return false;
+  long offset = 4 + 3 * sizeof(uint32_t);
+  for (int i = 0; i < s.ndeps; i++) {
+    offset += 3 * sizeof(int64_t) + sizeof(uint32_t) + strlen(s.deps[i].path);
+  }
+  script_free(&s);
+
+  FILE *f = fopen(cpath, "r+b");
+  if (f == NULL)
+    return false;
+  bool ok = fseek(f, offset, SEEK_SET) == 0
+    && fwrite(insn, sizeof(*insn), 1, f) == 1;
+  return fclose(f) == 0 && ok;
+}
+
+static void check_cache(void) {
+  char cpath[300];
+  struct stat st;
+  struct script_insn insn;
+  control_set_t cset;
+
+  write_file("inc.yi", "key b\n");
+  write_file("cached.yi", "key a\ninclude inc.yi\n");
+  report("cache written", types("cached.yi", true, "a b")
+         && (path_of(cpath, sizeof(cpath), "cached.yic"),
+             stat(cpath, &st) == 0));
+
+  // a valid but different instruction proves the cache is what runs
+  memset(&insn, 0, sizeof(insn));
+  insn.op = OP_KEY;
+  insn.arg = parse_cmd("z", &cset);
+  report("fresh cache used", patch_cache("cached.yi", &insn)
+         && types("cached.yi", true, "z b"));
+
+  // a jump out of bounds must not be trusted, the source is compiled again
+  insn.op = OP_JMP;
+  insn.arg = 1000;
+  report("corrupt cache rejected", patch_cache("cached.yi", &insn)
+         && types("cached.yi", true, "a b"));
+
+  // changing an included file invalidates the cache of the includer; the
+  // sizes change too, so this holds even with coarse timestamps
+  write_file("inc.yi", "key c\nkey d\n");
+  report("stale include recompiled", types("cached.yi", true, "a c d"));
+
+  write_file("cached.yi", "key e f\ninclude inc.yi\n");
+  report("stale source recompiled", types("cached.yi", true, "e f c d"));
+}
+
+int main(void) {
+  if (mkdtemp(dir) == NULL) {
+    perror("mkdtemp");
+    return 1;
+  }
+
+  check_comments();
+  check_loops();
+  check_jumps();
+  check_syntax();
+  check_includes();
+  check_cache();
+
+  if (failures > 0) {
+    fprintf(stderr, "%d script checks failed, files left in %s\n", failures,
+            dir);
+    return 1;
+  }
+  char cmd[64];
+  snprintf(cmd, sizeof(cmd), "rm -r %s", dir);
+  return system(cmd) == 0 ? 0 : 1;
+}
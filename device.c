@@ -0,0 +1,333 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <linux/uinput.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <X11/extensions/XInput.h>
+#include <X11/Xlib.h>
+
+#include "gamepad.h"
+#include "internal.h"
+
+#define SYS_INPUT_DIR "/sys/devices/virtual/input/"
+#define SYSPATH_MAX (sizeof(SYS_INPUT_DIR) + 64)
+#define DEVNODE_MAX 128
+// Longer than any key name with every modifier in front of it.
+#define SEQ_CMD_MAX 64
+// How long to wait for the event node to show up after UI_DEV_CREATE.
+#define DEVNODE_RETRIES 1000
+#define DEVNODE_RETRY_NS 1000000L
+
+struct youinput {
+  int fd;
+  char name[UINPUT_MAX_NAME_SIZE];
+  char devnode[DEVNODE_MAX];
+  lock_state_t locks;
+  int led_sink;
+};
+
+static int fetch_device_node(const char *path, char *devnode, size_t len);
+static int fetch_syspath_and_devnode(int fd, char *syspath, char *devnode);
+static int is_event_device(const struct dirent *dent);
+
+static int is_event_device(const struct dirent *dent) {
+        return strncmp("event", dent->d_name, 5) == 0;
+}
+
+// Writes the /dev/input node for the event device under path into devnode.
+// Uses readdir rather than scandir so nothing is left on the heap when this is
+// called repeatedly from the ensure_sys_device() retry loop.
+static int fetch_device_node(const char *path, char *devnode, size_t len) {
+  struct dirent *dent;
+  int rc = -1;
+
+  DIR *dir = opendir(path);
+  if (dir == NULL)
+    return -1;
+
+  /* there should only ever be one event device */
+  while ((dent = readdir(dir)) != NULL) {
+    if (!is_event_device(dent))
+      continue;
+    int n = snprintf(devnode, len, "/dev/input/%s", dent->d_name);
+    if (n > 0 && (size_t) n < len) {
+      rc = 0;
+      break;
+    }
+  }
+
+  closedir(dir);
+
+  return rc;
+}
+
+static int fetch_syspath_and_devnode(int fd, char *syspath, char *devnode) {
+  int rc;
+
+  strcpy(syspath, SYS_INPUT_DIR);
+  rc = ioctl(fd, UI_GET_SYSNAME(SYSPATH_MAX - strlen(SYS_INPUT_DIR)),
+             &syspath[strlen(SYS_INPUT_DIR)]);
+  if (rc == -1)
+    return -1;
+
+  return fetch_device_node(syspath, devnode, DEVNODE_MAX);
+}
+
+static void setup_keyboard(int fd) {
+  ioctl(fd, UI_SET_EVBIT, EV_KEY);
+
+  // 0 and 255 are reserved, highest I know of is KEY_MICMUTE
+  for (int i = 1; i < KEY_MICMUTE; i++) {
+    ioctl(fd, UI_SET_KEYBIT, i);
+  }
+
+  // the server writes lock state back to us, see read_locks()
+  ioctl(fd, UI_SET_EVBIT, EV_LED);
+  ioctl(fd, UI_SET_LEDBIT, LED_NUML);
+  ioctl(fd, UI_SET_LEDBIT, LED_CAPSL);
+  ioctl(fd, UI_SET_LEDBIT, LED_SCROLLL);
+}
+
+static int ensure_sys_device(int fd, char *devnode, const char *name,
+                             int flags) {
+  struct uinput_setup usetup;
+  char syspath[SYSPATH_MAX];
+  struct timespec ts = { 0, DEVNODE_RETRY_NS };
+
+  if (flags & YOUINPUT_GAMEPAD) {
+    gamepad_setup(fd);
+  } else {
+    setup_keyboard(fd);
+  }
+
+  memset(&usetup, 0, sizeof(usetup));
+  usetup.id.bustype = BUS_USB;
+  usetup.id.vendor = 0x1234;
+  usetup.id.product = (flags & YOUINPUT_GAMEPAD) ? 0x5679 : 0x5678;
+  snprintf(usetup.name, sizeof(usetup.name), "%s", name);
+
+  if (ioctl(fd, UI_DEV_SETUP, &usetup) == -1
+      || ioctl(fd, UI_DEV_CREATE) == -1)
+    return -1;
+
+  // the event node appears asynchronously, give up rather than spin forever
+  for (int i = 0; i < DEVNODE_RETRIES; i++) {
+    if (fetch_syspath_and_devnode(fd, syspath, devnode) == 0)
+      return 0;
+    (void) nanosleep(&ts, NULL);
+  }
+  ioctl(fd, UI_DEV_DESTROY);
+  return -1;
+}
+
+// Seeds the lock state from the kernel's copy of our LEDs. Later changes
+// arrive as EV_LED events on the uinput fd.
+static void fetch_locks(const char *devnode, lock_state_t *locks) {
+  unsigned char leds[(LED_MAX + 7) / 8];
+
+  int evfd = open(devnode, O_RDONLY | O_NONBLOCK);
+  if (evfd == -1)
+    return;
+  memset(leds, 0, sizeof(leds));
+  if (ioctl(evfd, EVIOCGLED(sizeof(leds)), leds) != -1) {
+    locks->caps = leds[LED_CAPSL / 8] & (1 << (LED_CAPSL % 8));
+    locks->num = leds[LED_NUML / 8] & (1 << (LED_NUML % 8));
+  }
+  close(evfd);
+}
+
+// This waits for the X11 system to pick up on the keyboard. However, we do some
+// hackery here with processes so that way we use the "default" keyboard of X11
+// rather than whatever the user has configured. We do this by forking a child,
+// and waiting for the keyboard to appear over there. I'm not sure why this
+// works exactly, if I did I probably wouldn't need to fork a child process.
+// Every handle has its own device name, so another handle's device that is
+// already known to X11 can't satisfy the wait.
+static int ensure_x11_device(const char *name) {
+  pid_t pid = fork();
+  if (pid == -1)
+    return -1;
+  if (pid == 0) {
+    for (;;) {
+      Display *dpy = XOpenDisplay(NULL);
+      if (dpy == NULL)
+        _exit(1);
+      int ndev;
+      XDeviceInfo *list = XListInputDevices(dpy, &ndev);
+      for (int i = 0; i < ndev; i++) {
+        if (strcmp(name, list[i].name) == 0) {
+          XFreeDeviceList(list);
+          XCloseDisplay(dpy);
+          // _exit, we may be a library inside someone else's process
+          _exit(0);
+        }
+      }
+      XFreeDeviceList(list);
+      XCloseDisplay(dpy);
+      struct timespec ts;
+      struct timespec remaining;
+      ts.tv_sec = 0;
+      // wait 1 milliseconds
+      ts.tv_nsec = 1000000;
+      // we explicitly ignore whether or not we get EINTR, we don't need
+      // anything exact.
+      (void) nanosleep(&ts, &remaining);
+    }
+  }
+
+  int status;
+  while (waitpid(pid, &status, 0) == -1) {
+    if (errno != EINTR)
+      return -1;
+  }
+  return 0;
+}
+
+youinput_t *youinput_open(int flags) {
+  static int handles = 0;
+
+  youinput_t *yi = calloc(1, sizeof(youinput_t));
+  if (yi == NULL)
+    return NULL;
+
+  // unique per handle, X11 only tells devices apart by name
+  snprintf(yi->name, sizeof(yi->name), "%s %d.%d",
+           (flags & YOUINPUT_GAMEPAD) ? "youinput gamepad" : "youinput device",
+           (int) getpid(), __atomic_fetch_add(&handles, 1, __ATOMIC_RELAXED));
+
+  // read access is for the LED state the server writes back
+  yi->led_sink = -1;
+  yi->fd = open("/dev/uinput", O_RDWR | O_NONBLOCK);
+  if (yi->fd == -1) {
+    free(yi);
+    return NULL;
+  }
+
+  if (ensure_sys_device(yi->fd, yi->devnode, yi->name, flags) < 0) {
+    close(yi->fd);
+    free(yi);
+    return NULL;
+  }
+
+  // X11 doesn't take gamepads as input devices, there is nothing to wait for
+  if ((flags & YOUINPUT_WAIT_X11) && !(flags & YOUINPUT_GAMEPAD)
+      && ensure_x11_device(yi->name) < 0) {
+    youinput_close(yi);
+    return NULL;
+  }
+
+  fetch_locks(yi->devnode, &yi->locks);
+
+  return yi;
+}
+
+int youinput_fd(const youinput_t *yi) {
+  return yi->fd;
+}
+
+// The device name as X11 and evdev see it, e.g. "youinput device 1234.0".
+const char *youinput_name(const youinput_t *yi) {
+  return yi->name;
+}
+
+// LED updates for our device are copied to evfd from now on, -1 stops it.
+void youinput_forward_leds(youinput_t *yi, int evfd) {
+  yi->led_sink = evfd;
+}
+
+// Picks up LED updates without emitting anything, for callers that wait on
+// youinput_fd() becoming readable.
+void youinput_poll_leds(youinput_t *yi) {
+  read_locks(yi->fd, &yi->locks, yi->led_sink);
+}
+
+int youinput_emit(youinput_t *yi, control_set_t cset, int code) {
+  read_locks(yi->fd, &yi->locks, yi->led_sink);
+  int presses = emit_combo(yi->fd, compensate_locks(cset, code, yi->locks), code);
+  track_locks(code, &yi->locks);
+  return presses;
+}
+
+int youinput_send(youinput_t *yi, const char *cmd) {
+  control_set_t cset;
+  // parse_cmd only advances through cmd, it never writes to it
+  int code = parse_cmd((char *) cmd, &cset);
+  if (code <= 0)
+    return -1;
+  return youinput_emit(yi, cset, code);
+}
+
+// Sends blank separated commands, as they would be given to youinput on the
+// command line.
+int youinput_send_seq(youinput_t *yi, const char *seq) {
+  char cmd[SEQ_CMD_MAX];
+  control_set_t cset;
+  int presses = 0;
+
+  // check everything first so bad input doesn't leave half a sequence typed
+  for (int pass = 0; pass < 2; pass++) {
+    const char *p = seq;
+    for (;;) {
+      p += strspn(p, " \t\n");
+      size_t len = strcspn(p, " \t\n");
+      if (len == 0)
+        break;
+      if (len >= sizeof(cmd))
+        return -1;
+      memcpy(cmd, p, len);
+      cmd[len] = '\0';
+      p += len;
+      int code = parse_cmd(cmd, &cset);
+      if (code <= 0)
+        return -1;
+      if (pass == 1)
+        presses += youinput_emit(yi, cset, code);
+    }
+  }
+  return presses;
+}
+
+// The command that types c, with line breaks and tabs as their keys.
+static char *text_cmd(char c, char *buf) {
+  if (c == '\n')
+    return "<return>";
+  if (c == '\t')
+    return "<tab>";
+  buf[0] = c;
+  buf[1] = '\0';
+  return buf;
+}
+
+int youinput_send_text(youinput_t *yi, const char *text) {
+  char buf[2];
+  control_set_t cset;
+  int presses = 0;
+
+  // check everything first so bad input doesn't leave half a string typed
+  for (const char *p = text; *p; p++) {
+    if (parse_cmd(text_cmd(*p, buf), &cset) <= 0)
+      return -1;
+  }
+  for (const char *p = text; *p; p++) {
+    int code = parse_cmd(text_cmd(*p, buf), &cset);
+    presses += youinput_emit(yi, cset, code);
+  }
+  return presses;
+}
+
+void youinput_close(youinput_t *yi) {
+  if (yi == NULL)
+    return;
+  ioctl(yi->fd, UI_DEV_DESTROY);
+  close(yi->fd);
+  free(yi);
+}
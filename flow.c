@@ -0,0 +1,152 @@
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <X11/extensions/XInput2.h>
+#include <X11/Xlib.h>
+
+#include "flow.h"
+
+#define FLOW_DELAY_STEP_NS 50000L
+#define FLOW_MAX_DELAY_NS 50000000L
+// If the server reports nothing for this long we stop waiting on it, raw
+// events can be lost (e.g. across a VT switch) and we must not hang.
+#define FLOW_STALL_MS 250
+
+static int find_xi2_device(Display *dpy, const char *name) {
+  int ndev;
+  int deviceid = -1;
+  XIDeviceInfo *info = XIQueryDevice(dpy, XIAllDevices, &ndev);
+
+  for (int i = 0; i < ndev; i++) {
+    if (info[i].use == XISlaveKeyboard && strcmp(name, info[i].name) == 0) {
+      deviceid = info[i].deviceid;
+      break;
+    }
+  }
+  XIFreeDeviceInfo(info);
+
+  return deviceid;
+}
+
+int flow_open(flow_t *flow, const char *name, long max_lag) {
+  int event, error;
+  int major = 2;
+  int minor = 2;
+
+  memset(flow, 0, sizeof(flow_t));
+  flow->max_lag = max_lag > 0 ? max_lag : FLOW_DEFAULT_MAX_LAG;
+
+  flow->dpy = XOpenDisplay(NULL);
+  if (flow->dpy == NULL) {
+    fprintf(stderr, "adaptive: cannot open X display\n");
+    return -1;
+  }
+
+  // Raw events are only delivered to the root window from XI 2.1 on.
+  if (!XQueryExtension(flow->dpy, "XInputExtension", &flow->xi_opcode,
+                       &event, &error)
+      || XIQueryVersion(flow->dpy, &major, &minor) != Success
+      || (major == 2 && minor < 1)) {
+    fprintf(stderr, "adaptive: XInput 2.1 is not available\n");
+    goto fail;
+  }
+
+  flow->deviceid = find_xi2_device(flow->dpy, name);
+  if (flow->deviceid < 0) {
+    fprintf(stderr, "adaptive: %s not found in X server\n", name);
+    goto fail;
+  }
+
+  unsigned char mask[XIMaskLen(XI_LASTEVENT)];
+  memset(mask, 0, sizeof(mask));
+  XISetMask(mask, XI_RawKeyPress);
+
+  XIEventMask evmask;
+  evmask.deviceid = flow->deviceid;
+  evmask.mask_len = sizeof(mask);
+  evmask.mask = mask;
+
+  XISelectEvents(flow->dpy, DefaultRootWindow(flow->dpy), &evmask, 1);
+  XSync(flow->dpy, False);
+
+  return 0;
+
+fail:
+  XCloseDisplay(flow->dpy);
+  flow->dpy = NULL;
+  return -1;
+}
+
+void flow_close(flow_t *flow) {
+  if (flow->dpy != NULL) {
+    XCloseDisplay(flow->dpy);
+    flow->dpy = NULL;
+  }
+}
+
+static void flow_drain(flow_t *flow) {
+  XEvent ev;
+
+  while (XPending(flow->dpy)) {
+    XNextEvent(flow->dpy, &ev);
+    if (ev.xcookie.type == GenericEvent
+        && ev.xcookie.extension == flow->xi_opcode
+        && ev.xcookie.evtype == XI_RawKeyPress) {
+      flow->seen++;
+    }
+  }
+}
+
+// Blocks until the server has caught up to within half of max_lag.
+static void flow_catch_up(flow_t *flow) {
+  struct pollfd pfd;
+  pfd.fd = ConnectionNumber(flow->dpy);
+  pfd.events = POLLIN;
+
+  while (flow->sent - flow->seen > flow->max_lag / 2) {
+    if (poll(&pfd, 1, FLOW_STALL_MS) <= 0) {
+      flow->seen = flow->sent;
+      return;
+    }
+    flow_drain(flow);
+  }
+}
+
+// Called before each command. Multiplicatively backs off when the server
+// falls more than max_lag presses behind, and additively speeds up again
+// while it keeps up, so the rate settles just under what the server and its
+// clients can absorb.
+void flow_wait(flow_t *flow) {
+  if (flow->dpy == NULL)
+    return;
+
+  flow_drain(flow);
+
+  if (flow->sent - flow->seen > flow->max_lag) {
+    if (flow->delay_ns == 0) {
+      flow->delay_ns = FLOW_DELAY_STEP_NS;
+    } else if (flow->delay_ns < FLOW_MAX_DELAY_NS / 2) {
+      flow->delay_ns *= 2;
+    } else {
+      flow->delay_ns = FLOW_MAX_DELAY_NS;
+    }
+    flow_catch_up(flow);
+  } else if (flow->delay_ns > FLOW_DELAY_STEP_NS) {
+    flow->delay_ns -= FLOW_DELAY_STEP_NS;
+  } else {
+    flow->delay_ns = 0;
+  }
+
+  if (flow->delay_ns > 0) {
+    struct timespec ts;
+    ts.tv_sec = flow->delay_ns / 1000000000L;
+    ts.tv_nsec = flow->delay_ns % 1000000000L;
+    (void) nanosleep(&ts, NULL);
+  }
+}
+
+void flow_sent(flow_t *flow, int presses) {
+  flow->sent += presses;
+}
@@ -0,0 +1,30 @@
+#ifndef YOUINPUT_FLOW_H
+#define YOUINPUT_FLOW_H
+
+#include <X11/Xlib.h>
+
+#define FLOW_DEFAULT_MAX_LAG 16
+
+// Adaptive flow control. Key presses injected through uinput are counted
+// against the XI2 raw key presses the X server reports for the youinput
+// device; the difference is how far the server lags behind us. The
+// inter-key delay grows when the lag passes max_lag and shrinks back while
+// the server keeps up.
+struct flow {
+  Display *dpy;
+  int xi_opcode;
+  int deviceid;
+  long sent;
+  long seen;
+  long max_lag;
+  long delay_ns;
+};
+
+typedef struct flow flow_t;
+
+int flow_open(flow_t *flow, const char *name, long max_lag);
+void flow_close(flow_t *flow);
+void flow_wait(flow_t *flow);
+void flow_sent(flow_t *flow, int presses);
+
+#endif
@@ -0,0 +1,279 @@
+#include <poll.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include <X11/Xatom.h>
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+
+#include "focus.h"
+#include "stop.h"
+
+// Error handlers are per process, these let the one we install tell our
+// connection apart and hand everything else on.
+static Display *focus_dpy = NULL;
+static XErrorHandler previous_handler = NULL;
+
+// The windows we watch can be destroyed before we stop watching them, which
+// must not take the whole process down. Errors on other connections, like
+// the adaptive flow one, go to whoever handled them before us.
+static int ignore_bad_window(Display *dpy, XErrorEvent *ev) {
+  if (dpy == focus_dpy && ev->error_code == BadWindow)
+    return 0;
+  return previous_handler != NULL ? previous_handler(dpy, ev) : 0;
+}
+
+static bool get_cardinal(focus_t *f, Window w, Atom prop, Atom type,
+                         unsigned long *out) {
+  Atom actual;
+  int format;
+  unsigned long n, after;
+  unsigned char *data = NULL;
+  bool ok = false;
+
+  if (XGetWindowProperty(f->dpy, w, prop, 0, 1, False, type, &actual, &format,
+                         &n, &after, &data) == Success
+      && data != NULL && n == 1 && format == 32) {
+    *out = *(unsigned long *) data;
+    ok = true;
+  }
+  if (data != NULL)
+    XFree(data);
+  return ok;
+}
+
+static bool name_matches(focus_t *f, Window w) {
+  Atom actual;
+  int format;
+  unsigned long n, after;
+  unsigned char *data = NULL;
+  char *name = NULL;
+  bool match = false;
+
+  if (XGetWindowProperty(f->dpy, w, f->net_wm_name, 0, 1024, False,
+                         f->utf8_string, &actual, &format, &n, &after,
+                         &data) == Success && data != NULL && n > 0) {
+    match = strstr((char *) data, f->name) != NULL;
+  } else if (XFetchName(f->dpy, w, &name) && name != NULL) {
+    match = strstr(name, f->name) != NULL;
+  }
+  if (data != NULL)
+    XFree(data);
+  if (name != NULL)
+    XFree(name);
+  return match;
+}
+
+static bool class_matches(focus_t *f, Window w) {
+  XClassHint hint;
+  bool match = false;
+
+  if (XGetClassHint(f->dpy, w, &hint)) {
+    match = (hint.res_class != NULL && strcmp(hint.res_class, f->class) == 0)
+      || (hint.res_name != NULL && strcmp(hint.res_name, f->class) == 0);
+    if (hint.res_class != NULL)
+      XFree(hint.res_class);
+    if (hint.res_name != NULL)
+      XFree(hint.res_name);
+  }
+  return match;
+}
+
+// Every given criterion has to hold for the same window.
+static bool window_matches(focus_t *f, Window w) {
+  unsigned long pid;
+
+  if (f->pid > 0 && (!get_cardinal(f, w, f->net_wm_pid, XA_CARDINAL, &pid)
+                     || (long) pid != f->pid))
+    return false;
+  if (f->class != NULL && !class_matches(f, w))
+    return false;
+  if (f->name != NULL && !name_matches(f, w))
+    return false;
+  return true;
+}
+
+// XGetInputFocus often names a child of the client window, so the client
+// may be any ancestor below the root. Collects w and those ancestors.
+static int window_chain(focus_t *f, Window w, Window *chain) {
+  Window root = DefaultRootWindow(f->dpy);
+  int n = 0;
+
+  while (w != None && w != root && n < FOCUS_MAX_DEPTH) {
+    Window parent, *children = NULL;
+    unsigned int nchildren;
+
+    chain[n++] = w;
+    if (!XQueryTree(f->dpy, w, &root, &parent, &children, &nchildren))
+      break;
+    if (children != NULL)
+      XFree(children);
+    w = parent;
+  }
+  return n;
+}
+
+static bool in_chain(const Window *chain, int n, Window w) {
+  for (int i = 0; i < n; i++) {
+    if (chain[i] == w)
+      return true;
+  }
+  return false;
+}
+
+static Window focused_window(focus_t *f) {
+  unsigned long active;
+  Window w;
+  int revert;
+
+  if (f->ewmh && get_cardinal(f, DefaultRootWindow(f->dpy),
+                              f->net_active_window, XA_WINDOW, &active))
+    return active;
+
+  XGetInputFocus(f->dpy, &w, &revert);
+  return w == PointerRoot ? None : w;
+}
+
+// Watches the focused window for focus changes, and it and its ancestors for
+// title changes and going away, since the window that decides a match (and
+// so holds the title) is usually the toplevel above the focused one.
+static void focus_refresh(focus_t *f) {
+  Window chain[FOCUS_MAX_DEPTH];
+  Window w = focused_window(f);
+  int n = w == None ? 0 : window_chain(f, w, chain);
+
+  for (int i = 0; i < f->nwatched; i++) {
+    if (!in_chain(chain, n, f->watched[i]))
+      XSelectInput(f->dpy, f->watched[i], NoEventMask);
+  }
+  f->matched = false;
+  for (int i = 0; i < n; i++) {
+    XSelectInput(f->dpy, chain[i], (i == 0 ? FocusChangeMask : 0)
+                 | PropertyChangeMask | StructureNotifyMask);
+    f->watched[i] = chain[i];
+    if (!f->matched && window_matches(f, chain[i]))
+      f->matched = true;
+  }
+  f->nwatched = n;
+}
+
+// The round trips in focus_refresh() can pull more events into Xlib's queue,
+// where poll() on the socket won't see them, so this only returns once the
+// queue is empty after the last refresh.
+static void focus_drain(focus_t *f) {
+  XEvent ev;
+
+  while (XPending(f->dpy)) {
+    bool dirty = false;
+    while (XPending(f->dpy)) {
+      XNextEvent(f->dpy, &ev);
+      switch (ev.type) {
+        case FocusIn:
+        case FocusOut:
+        case DestroyNotify:
+        case UnmapNotify:
+        case ReparentNotify:
+          dirty = true;
+          break;
+        case PropertyNotify:
+          if (ev.xproperty.atom == f->net_active_window
+              || ev.xproperty.atom == f->net_wm_name
+              || ev.xproperty.atom == XA_WM_NAME)
+            dirty = true;
+          break;
+      }
+    }
+    if (dirty)
+      focus_refresh(f);
+  }
+}
+
+int focus_open(focus_t *f, const char *name, const char *class, long pid) {
+  unsigned long active;
+
+  memset(f, 0, sizeof(focus_t));
+  f->name = name;
+  f->class = class;
+  f->pid = pid;
+
+  f->dpy = XOpenDisplay(NULL);
+  if (f->dpy == NULL) {
+    fprintf(stderr, "focus: cannot open X display\n");
+    return -1;
+  }
+  focus_dpy = f->dpy;
+  previous_handler = XSetErrorHandler(ignore_bad_window);
+
+  f->net_active_window = XInternAtom(f->dpy, "_NET_ACTIVE_WINDOW", False);
+  f->net_wm_name = XInternAtom(f->dpy, "_NET_WM_NAME", False);
+  f->net_wm_pid = XInternAtom(f->dpy, "_NET_WM_PID", False);
+  f->utf8_string = XInternAtom(f->dpy, "UTF8_STRING", False);
+
+  Window root = DefaultRootWindow(f->dpy);
+  f->ewmh = get_cardinal(f, root, f->net_active_window, XA_WINDOW, &active);
+  // FocusChangeMask on the root sees focus arrive from PointerRoot or None,
+  // when there is no focused window of our own to watch
+  XSelectInput(f->dpy, root, PropertyChangeMask | FocusChangeMask);
+
+  focus_refresh(f);
+  return 0;
+}
+
+void focus_close(focus_t *f) {
+  if (f->dpy != NULL) {
+    XCloseDisplay(f->dpy);
+    f->dpy = NULL;
+    XSetErrorHandler(previous_handler);
+    focus_dpy = NULL;
+  }
+}
+
+static long elapsed_ms(const struct timespec *start) {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (now.tv_sec - start->tv_sec) * 1000
+    + (now.tv_nsec - start->tv_nsec) / 1000000;
+}
+
+// Returns 0 at once if the target window has focus, otherwise waits for it
+// and returns 1. A negative timeout waits forever; returns -1 if the timeout
+// passes first or a stop is requested while waiting.
+int focus_wait(focus_t *f, long timeout_ms) {
+  struct pollfd pfd[2];
+  struct timespec start;
+
+  if (f->dpy == NULL)
+    return 0;
+
+  focus_drain(f);
+  if (f->matched)
+    return 0;
+
+  pfd[0].fd = ConnectionNumber(f->dpy);
+  pfd[0].events = POLLIN;
+  // -1 until stop_init(), which poll() skips
+  pfd[1].fd = stop_fd();
+  pfd[1].events = POLLIN;
+  clock_gettime(CLOCK_MONOTONIC, &start);
+
+  while (!f->matched) {
+    if (stop_requested())
+      return -1;
+    // poll() only sees the socket, never wait while events sit in the queue
+    if (XEventsQueued(f->dpy, QueuedAlready) > 0) {
+      focus_drain(f);
+      continue;
+    }
+    long remaining = -1;
+    if (timeout_ms >= 0) {
+      remaining = timeout_ms - elapsed_ms(&start);
+      if (remaining <= 0)
+        return -1;
+    }
+    if (poll(pfd, 2, remaining) == 0)
+      return -1;
+    focus_drain(f);
+  }
+  return 1;
+}
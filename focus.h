@@ -0,0 +1,35 @@
+#ifndef YOUINPUT_FOCUS_H
+#define YOUINPUT_FOCUS_H
+
+#include <stdbool.h>
+
+#include <X11/Xlib.h>
+
+#define FOCUS_MAX_DEPTH 16
+
+// Tracks whether the window with input focus is the one we mean to type
+// into. Focus and title changes arrive as X events, nothing is polled: the
+// root window's _NET_ACTIVE_WINDOW for EWMH window managers, and FocusIn/Out
+// on the root and the focused window for everything else.
+struct focus {
+  Display *dpy;
+  Atom net_active_window;
+  Atom net_wm_name;
+  Atom net_wm_pid;
+  Atom utf8_string;
+  bool ewmh;
+  Window watched[FOCUS_MAX_DEPTH];
+  int nwatched;
+  bool matched;
+  const char *name;
+  const char *class;
+  long pid;
+};
+
+typedef struct focus focus_t;
+
+int focus_open(focus_t *focus, const char *name, const char *class, long pid);
+void focus_close(focus_t *focus);
+int focus_wait(focus_t *focus, long timeout_ms);
+
+#endif
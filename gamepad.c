@@ -0,0 +1,260 @@
+#include <errno.h>
+#include <linux/uinput.h>
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "gamepad.h"
+#include "internal.h"
+
+#define STICK_MIN -32768
+#define STICK_MAX 32767
+
+// The gamepad profile: every channel a curve can drive, with the absinfo
+// the device advertises for axes.
+static const struct pad_channel channels[] = {
+  { "x", EV_ABS, ABS_X, STICK_MIN, STICK_MAX, 16, 128 },
+  { "y", EV_ABS, ABS_Y, STICK_MIN, STICK_MAX, 16, 128 },
+  { "rx", EV_ABS, ABS_RX, STICK_MIN, STICK_MAX, 16, 128 },
+  { "ry", EV_ABS, ABS_RY, STICK_MIN, STICK_MAX, 16, 128 },
+  { "lt", EV_ABS, ABS_Z, 0, 255, 0, 0 },
+  { "rt", EV_ABS, ABS_RZ, 0, 255, 0, 0 },
+  { "hatx", EV_ABS, ABS_HAT0X, -1, 1, 0, 0 },
+  { "haty", EV_ABS, ABS_HAT0Y, -1, 1, 0, 0 },
+  { "south", EV_KEY, BTN_SOUTH, 0, 1, 0, 0 },
+  { "east", EV_KEY, BTN_EAST, 0, 1, 0, 0 },
+  { "north", EV_KEY, BTN_NORTH, 0, 1, 0, 0 },
+  { "west", EV_KEY, BTN_WEST, 0, 1, 0, 0 },
+  { "tl", EV_KEY, BTN_TL, 0, 1, 0, 0 },
+  { "tr", EV_KEY, BTN_TR, 0, 1, 0, 0 },
+  { "tl2", EV_KEY, BTN_TL2, 0, 1, 0, 0 },
+  { "tr2", EV_KEY, BTN_TR2, 0, 1, 0, 0 },
+  { "select", EV_KEY, BTN_SELECT, 0, 1, 0, 0 },
+  { "start", EV_KEY, BTN_START, 0, 1, 0, 0 },
+  { "mode", EV_KEY, BTN_MODE, 0, 1, 0, 0 },
+  { "thumbl", EV_KEY, BTN_THUMBL, 0, 1, 0, 0 },
+  { "thumbr", EV_KEY, BTN_THUMBR, 0, 1, 0, 0 },
+};
+
+#define NCHANNELS (sizeof(channels) / sizeof(channels[0]))
+
+static const char *shape_names[] = {
+  [PAD_HOLD] = "hold",
+  [PAD_RAMP] = "ramp",
+  [PAD_TRIANGLE] = "triangle",
+  [PAD_SINE] = "sine",
+  [PAD_SQUARE] = "square",
+};
+
+void gamepad_setup(int fd) {
+  struct uinput_abs_setup abs;
+
+  ioctl(fd, UI_SET_EVBIT, EV_KEY);
+  ioctl(fd, UI_SET_EVBIT, EV_ABS);
+  for (size_t i = 0; i < NCHANNELS; i++) {
+    if (channels[i].type == EV_KEY) {
+      ioctl(fd, UI_SET_KEYBIT, channels[i].code);
+      continue;
+    }
+    memset(&abs, 0, sizeof(abs));
+    abs.code = channels[i].code;
+    abs.absinfo.minimum = channels[i].min;
+    abs.absinfo.maximum = channels[i].max;
+    abs.absinfo.fuzz = channels[i].fuzz;
+    abs.absinfo.flat = channels[i].flat;
+    ioctl(fd, UI_SET_ABSBIT, channels[i].code);
+    ioctl(fd, UI_ABS_SETUP, &abs);
+  }
+}
+
+static int parse_double(const char *s, double *out) {
+  char *end;
+  errno = 0;
+  *out = strtod(s, &end);
+  return (errno || end == s || *end != '\0') ? -1 : 0;
+}
+
+// spec is "<channel>:hold:<value>" or
+// "<channel>:<ramp|triangle|sine|square>:<from>:<to>:<period ms>[:<phase ms>]"
+int youinput_pad_add_curve(youinput_pad_t *pad, const char *spec) {
+  char buf[128];
+  char *fields[6];
+  int nfields = 0;
+  char *save;
+
+  if (pad->ncurves == PAD_MAX_CURVES || strlen(spec) >= sizeof(buf))
+    goto bad;
+  strcpy(buf, spec);
+  for (char *f = strtok_r(buf, ":", &save); f != NULL && nfields < 6;
+       f = strtok_r(NULL, ":", &save)) {
+    fields[nfields++] = f;
+  }
+  if (nfields < 3)
+    goto bad;
+
+  struct pad_curve *c = &pad->curves[pad->ncurves];
+  memset(c, 0, sizeof(*c));
+  for (size_t i = 0; i < NCHANNELS; i++) {
+    if (strcmp(fields[0], channels[i].name) == 0)
+      c->channel = &channels[i];
+  }
+  for (int i = 0; i < pad->ncurves; i++) {
+    if (pad->curves[i].channel == c->channel) {
+      fprintf(stderr, "gamepad: %s is already driven\n", fields[0]);
+      return -1;
+    }
+  }
+
+  int shape = -1;
+  for (size_t i = 0; i < sizeof(shape_names) / sizeof(shape_names[0]); i++) {
+    if (strcmp(fields[1], shape_names[i]) == 0)
+      shape = i;
+  }
+  if (c->channel == NULL || shape < 0)
+    goto bad;
+  c->shape = shape;
+
+  if (shape == PAD_HOLD) {
+    if (nfields != 3 || parse_double(fields[2], &c->from) < 0)
+      goto bad;
+  } else {
+    if (nfields < 5
+        || parse_double(fields[2], &c->from) < 0
+        || parse_double(fields[3], &c->to) < 0
+        || parse_double(fields[4], &c->period_ms) < 0
+        || c->period_ms <= 0
+        || (nfields == 6 && parse_double(fields[5], &c->phase_ms) < 0))
+      goto bad;
+  }
+
+  pad->ncurves++;
+  return 0;
+
+bad:
+  fprintf(stderr, "gamepad: bad curve %s\n", spec);
+  return -1;
+}
+
+static int32_t curve_value(const struct pad_curve *c, double t_ms) {
+  double p = 0, v;
+
+  if (c->shape != PAD_HOLD) {
+    p = fmod(t_ms + c->phase_ms, c->period_ms) / c->period_ms;
+    if (p < 0)
+      p += 1;
+  }
+  switch (c->shape) {
+    case PAD_RAMP:
+      v = c->from + (c->to - c->from) * p;
+      break;
+    case PAD_TRIANGLE:
+      v = p < 0.5 ? c->from + (c->to - c->from) * 2 * p
+                  : c->to - (c->to - c->from) * (2 * p - 1);
+      break;
+    case PAD_SINE:
+      v = (c->from + c->to) / 2 + (c->to - c->from) / 2 * sin(2 * M_PI * p);
+      break;
+    case PAD_SQUARE:
+      v = p < 0.5 ? c->from : c->to;
+      break;
+    default:
+      v = c->from;
+      break;
+  }
+
+  v = lround(v);
+  if (v < c->channel->min)
+    v = c->channel->min;
+  if (v > c->channel->max)
+    v = c->channel->max;
+  return v;
+}
+
+// Emits one frame for time t_ms: only the channels whose value changed, and
+// one SYN_REPORT, in a single write. Returns the number of channels written.
+int youinput_pad_tick(youinput_pad_t *pad, int fd, double t_ms) {
+  struct input_event ev[PAD_MAX_CURVES + 1];
+  int n = 0;
+
+  memset(ev, 0, sizeof(ev));
+  for (int i = 0; i < pad->ncurves; i++) {
+    int32_t v = curve_value(&pad->curves[i], t_ms);
+    if (pad->primed && v == pad->last[i])
+      continue;
+    pad->last[i] = v;
+    ev[n].type = pad->curves[i].channel->type;
+    ev[n].code = pad->curves[i].channel->code;
+    ev[n].value = v;
+    n++;
+  }
+  pad->primed = true;
+  if (n == 0)
+    return 0;
+
+  ev[n].type = EV_SYN;
+  ev[n].code = SYN_REPORT;
+  (void) write(fd, ev, (n + 1) * sizeof(ev[0]));
+  pad->frames++;
+  pad->events += n;
+  return n;
+}
+
+static double ms_between(const struct timespec *a, const struct timespec *b) {
+  return (b->tv_sec - a->tv_sec) * 1e3 + (b->tv_nsec - a->tv_nsec) / 1e6;
+}
+
+static int64_t ns_between(const struct timespec *a, const struct timespec *b) {
+  return (int64_t) (b->tv_sec - a->tv_sec) * 1000000000LL
+    + (b->tv_nsec - a->tv_nsec);
+}
+
+static void advance(struct timespec *ts, int64_t ns) {
+  ns += ts->tv_nsec;
+  ts->tv_sec += ns / 1000000000LL;
+  ts->tv_nsec = ns % 1000000000LL;
+}
+
+// Ticks at rate_hz on absolute deadlines until duration_ms has passed (or
+// forever if it is 0) or youinput_pad_stop() is called on pad. Missed
+// deadlines are counted as overruns and skipped rather than made up. Returns
+// -1 if rate_hz is out of range.
+int youinput_pad_run(youinput_pad_t *pad, int fd, long rate_hz,
+                     long duration_ms) {
+  struct timespec start, next, now;
+
+  if (rate_hz <= 0 || rate_hz > PAD_MAX_RATE)
+    return -1;
+  long period_ns = 1000000000L / rate_hz;
+
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  next = start;
+  while (!pad->stop) {
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    double t_ms = ms_between(&start, &now);
+    if (duration_ms > 0 && t_ms >= duration_ms)
+      break;
+    youinput_pad_tick(pad, fd, t_ms);
+
+    advance(&next, period_ns);
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    int64_t behind = ns_between(&next, &now);
+    if (behind > 0) {
+      // behind schedule, resynchronise on the next whole period from now
+      int64_t missed = behind / period_ns + 1;
+      pad->overruns += missed;
+      advance(&next, missed * period_ns);
+    }
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &next, NULL);
+  }
+  pad->stop = 0;
+  return 0;
+}
+
+// Safe to call from a signal handler.
+void youinput_pad_stop(youinput_pad_t *pad) {
+  pad->stop = 1;
+}
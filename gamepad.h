@@ -0,0 +1,73 @@
+#ifndef YOUINPUT_GAMEPAD_H
+#define YOUINPUT_GAMEPAD_H
+
+#include <signal.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "youinput.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define PAD_MAX_CURVES 32
+#define PAD_DEFAULT_RATE 1000
+// One tick per nanosecond, the resolution of the deadlines.
+#define PAD_MAX_RATE 1000000000L
+
+struct pad_channel {
+  const char *name;
+  int type;
+  int code;
+  int min;
+  int max;
+  int fuzz;
+  int flat;
+};
+
+enum pad_shape {
+  PAD_HOLD,
+  PAD_RAMP,
+  PAD_TRIANGLE,
+  PAD_SINE,
+  PAD_SQUARE,
+};
+
+// A channel driven by a periodic function of time, see
+// youinput_pad_add_curve().
+struct pad_curve {
+  const struct pad_channel *channel;
+  enum pad_shape shape;
+  double from;
+  double to;
+  double period_ms;
+  double phase_ms;
+};
+
+// Curves are evaluated against wall time, not tick count, so a late tick
+// skips ahead instead of falling further behind.
+struct youinput_pad {
+  struct pad_curve curves[PAD_MAX_CURVES];
+  int ncurves;
+  int32_t last[PAD_MAX_CURVES];
+  bool primed;
+  uint64_t frames;
+  uint64_t events;
+  uint64_t overruns;
+  volatile sig_atomic_t stop;
+};
+
+typedef struct youinput_pad youinput_pad_t;
+
+YOUINPUT_API int youinput_pad_add_curve(youinput_pad_t *pad, const char *spec);
+YOUINPUT_API int youinput_pad_tick(youinput_pad_t *pad, int fd, double t_ms);
+YOUINPUT_API int youinput_pad_run(youinput_pad_t *pad, int fd, long rate_hz,
+                                  long duration_ms);
+YOUINPUT_API void youinput_pad_stop(youinput_pad_t *pad);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
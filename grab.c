@@ -0,0 +1,310 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/ioctl.h>
+#include <unistd.h>
+
+#include "grab.h"
+#include "internal.h"
+#include "stop.h"
+
+static const int modifier_keys[] = {
+  KEY_LEFTCTRL, KEY_RIGHTCTRL, KEY_LEFTSHIFT, KEY_RIGHTSHIFT,
+  KEY_LEFTMETA, KEY_RIGHTMETA, KEY_LEFTALT, KEY_RIGHTALT,
+};
+
+#define NMODIFIERS (sizeof(modifier_keys) / sizeof(modifier_keys[0]))
+
+static bool bit_test(const unsigned char *bits, int code) {
+  return bits[code / 8] & (1 << (code % 8));
+}
+
+static void bit_set(unsigned char *bits, int code, bool on) {
+  if (on)
+    bits[code / 8] |= 1 << (code % 8);
+  else
+    bits[code / 8] &= ~(1 << (code % 8));
+}
+
+// Hotkeys may already have been added to g, which must start out zeroed.
+int grab_open(grab_t *g, const char *devpath, youinput_t *yi) {
+  g->evfd = open(devpath, O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (g->evfd == -1) {
+    fprintf(stderr, "%s: %s\n", devpath, strerror(errno));
+    return -1;
+  }
+
+  // Keys held while we start would otherwise stay down forever, since their
+  // release goes only to us. Let them go first.
+  unsigned char keys[(KEY_MAX + 8) / 8];
+  bool any = true;
+  for (int tries = 0; any && tries < 200; tries++) {
+    memset(keys, 0, sizeof(keys));
+    ioctl(g->evfd, EVIOCGKEY(sizeof(keys)), keys);
+    any = false;
+    for (size_t i = 0; i < sizeof(keys); i++)
+      any = any || keys[i];
+    if (any)
+      usleep(10000);
+  }
+  if (any) {
+    fprintf(stderr, "%s: keys still held, not grabbing\n", devpath);
+    close(g->evfd);
+    return -1;
+  }
+
+  if (ioctl(g->evfd, EVIOCGRAB, 1) == -1) {
+    fprintf(stderr, "%s: grab: %s\n", devpath, strerror(errno));
+    close(g->evfd);
+    return -1;
+  }
+
+  // the physical keyboard shows the lock state of the keyboard it now feeds
+  g->yi = yi;
+  youinput_forward_leds(yi, g->evfd);
+  return 0;
+}
+
+// spec is "<chord>=<script>", split at the last '=' so "C-==f.yi" binds C-=.
+int grab_add_hotkey(grab_t *g, const char *spec, bool use_cache) {
+  char chord[64];
+  const char *eq = strrchr(spec, '=');
+
+  if (eq == NULL || eq == spec || (size_t) (eq - spec) >= sizeof(chord)
+      || eq[1] == '\0') {
+    fprintf(stderr, "hotkey: expected <chord>=<script>, got %s\n", spec);
+    return -1;
+  }
+  if (g->nhotkeys == GRAB_MAX_HOTKEYS) {
+    fprintf(stderr, "hotkey: at most %d hotkeys\n", GRAB_MAX_HOTKEYS);
+    return -1;
+  }
+
+  memcpy(chord, spec, eq - spec);
+  chord[eq - spec] = '\0';
+
+  struct hotkey *hk = &g->hotkeys[g->nhotkeys];
+  hk->code = parse_cmd(chord, &hk->cset);
+  if (hk->code <= 0) {
+    fprintf(stderr, "hotkey: cannot parse %s\n", chord);
+    return -1;
+  }
+  // compiled up front, a hotkey only ever costs running the bytecode
+  if (script_load(&hk->script, eq + 1, use_cache) < 0)
+    return -1;
+  g->nhotkeys++;
+  return 0;
+}
+
+static bool held(const grab_t *g, int left, int right) {
+  return bit_test(g->down, left) || bit_test(g->down, right);
+}
+
+static struct hotkey *match_hotkey(grab_t *g, int code) {
+  for (int i = 0; i < g->nhotkeys; i++) {
+    struct hotkey *hk = &g->hotkeys[i];
+    if (hk->code == code
+        && hk->cset.ctrl == held(g, KEY_LEFTCTRL, KEY_RIGHTCTRL)
+        && hk->cset.shift == held(g, KEY_LEFTSHIFT, KEY_RIGHTSHIFT)
+        && hk->cset.meta == held(g, KEY_LEFTMETA, KEY_RIGHTMETA)
+        && hk->cset.alt == held(g, KEY_LEFTALT, KEY_RIGHTALT))
+      return hk;
+  }
+  return NULL;
+}
+
+// The hotkey's modifiers are down on our device; lift them for the macro and
+// put back whatever is still physically held afterwards.
+static void set_held_modifiers(grab_t *g, int val) {
+  int fd = youinput_fd(g->yi);
+  bool any = false;
+
+  for (size_t i = 0; i < NMODIFIERS; i++) {
+    if (bit_test(g->down, modifier_keys[i])) {
+      emit(fd, EV_KEY, modifier_keys[i], val);
+      any = true;
+    }
+  }
+  if (any)
+    emit(fd, EV_SYN, SYN_REPORT, 0);
+}
+
+static void run_hotkey(grab_t *g, struct hotkey *hk, script_emit_fn emit_fn,
+                       void *ctx) {
+  set_held_modifiers(g, 0);
+  script_run(&hk->script, emit_fn, ctx);
+  set_held_modifiers(g, 1);
+}
+
+// Returns true if the event belongs to a hotkey and must not be passed on.
+static bool filter_key(grab_t *g, const struct input_event *ev,
+                       struct hotkey **fire) {
+  if (ev->code > KEY_MAX)
+    return false;
+  if (bit_test(g->swallowed, ev->code)) {
+    if (ev->value == 0)
+      bit_set(g->swallowed, ev->code, false);
+    return true;
+  }
+  if (ev->value == 1) {
+    struct hotkey *hk = match_hotkey(g, ev->code);
+    if (hk != NULL) {
+      bit_set(g->swallowed, ev->code, true);
+      *fire = hk;
+      return true;
+    }
+  }
+  if (ev->value != 2)
+    bit_set(g->down, ev->code, ev->value);
+  return false;
+}
+
+// After SYN_DROPPED our idea of which keys are down may be stale. Reads the
+// real state back and sends whatever changed, so nothing stays stuck.
+static void resync(grab_t *g) {
+  unsigned char keys[(KEY_MAX + 8) / 8];
+  int fd = youinput_fd(g->yi);
+  bool any = false;
+
+  memset(keys, 0, sizeof(keys));
+  if (ioctl(g->evfd, EVIOCGKEY(sizeof(keys)), keys) == -1)
+    return;
+  for (int code = 0; code <= KEY_MAX; code++) {
+    bool now = bit_test(keys, code);
+    // a swallowed chord key never reached our device either way
+    if (bit_test(g->swallowed, code)) {
+      if (!now)
+        bit_set(g->swallowed, code, false);
+      continue;
+    }
+    if (now == bit_test(g->down, code))
+      continue;
+    bit_set(g->down, code, now);
+    emit(fd, EV_KEY, code, now);
+    any = true;
+  }
+  if (any)
+    emit(fd, EV_SYN, SYN_REPORT, 0);
+}
+
+// Replays what one read() returned. Events are compacted in place and each
+// SYN_REPORT frame goes out in a single write. On SYN_DROPPED the partial
+// frame and everything up to the next SYN_REPORT are discarded and the key
+// state is read back from the device instead.
+static void pass_through(grab_t *g, struct input_event *ev, int n,
+                         script_emit_fn emit_fn, void *ctx) {
+  int fd = youinput_fd(g->yi);
+  int out = 0;
+  struct hotkey *fire = NULL;
+
+  for (int i = 0; i < n; i++) {
+    if (ev[i].type == EV_SYN && ev[i].code == SYN_DROPPED) {
+      g->dropping = true;
+      out = 0;
+      fire = NULL;
+      continue;
+    }
+    if (g->dropping) {
+      if (ev[i].type == EV_SYN && ev[i].code == SYN_REPORT) {
+        g->dropping = false;
+        resync(g);
+      }
+      continue;
+    }
+    if (ev[i].type == EV_KEY && filter_key(g, &ev[i], &fire))
+      continue;
+    ev[out++] = ev[i];
+    if (ev[i].type != EV_SYN || ev[i].code != SYN_REPORT)
+      continue;
+
+    // a frame that only held swallowed keys is just its SYN, drop it
+    if (out > 1)
+      (void) write(fd, ev, out * sizeof(ev[0]));
+    if (fire != NULL) {
+      run_hotkey(g, fire, emit_fn, ctx);
+      fire = NULL;
+    }
+    // later events only ever move down, over what was just written
+    out = 0;
+  }
+  // an unterminated frame finishes with the next read
+  if (out > 0)
+    (void) write(fd, ev, out * sizeof(ev[0]));
+  if (fire != NULL)
+    run_hotkey(g, fire, emit_fn, ctx);
+}
+
+// Runs until SIGINT/SIGTERM or the keyboard goes away. The stop fd is polled
+// with the keyboard, so a signal during a hotkey script isn't missed.
+int grab_run(grab_t *g, script_emit_fn emit_fn, void *ctx) {
+  struct input_event ev[GRAB_BATCH];
+  struct epoll_event events[3];
+  bool done = false;
+  int rc = 0;
+
+  if (stop_init() < 0)
+    return -1;
+  int epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (epfd == -1)
+    return -1;
+  memset(events, 0, sizeof(events));
+  events[0].events = EPOLLIN;
+  events[0].data.fd = g->evfd;
+  events[1].events = EPOLLIN;
+  events[1].data.fd = youinput_fd(g->yi);
+  events[2].events = EPOLLIN;
+  events[2].data.fd = stop_fd();
+  if (epoll_ctl(epfd, EPOLL_CTL_ADD, g->evfd, &events[0]) == -1
+      || epoll_ctl(epfd, EPOLL_CTL_ADD, youinput_fd(g->yi), &events[1]) == -1
+      || epoll_ctl(epfd, EPOLL_CTL_ADD, stop_fd(), &events[2]) == -1) {
+    close(epfd);
+    return -1;
+  }
+
+  while (!done) {
+    int n = epoll_wait(epfd, events, 3, -1);
+    if (n == -1) {
+      if (errno == EINTR)
+        continue;
+      rc = -1;
+      break;
+    }
+    for (int i = 0; i < n; i++) {
+      if (events[i].data.fd == stop_fd()) {
+        done = true;
+        continue;
+      }
+      if (events[i].data.fd != g->evfd) {
+        youinput_poll_leds(g->yi);
+        continue;
+      }
+      ssize_t len;
+      while ((len = read(g->evfd, ev, sizeof(ev))) > 0) {
+        pass_through(g, ev, len / sizeof(ev[0]), emit_fn, ctx);
+      }
+      if (len == -1 && errno == ENODEV) {
+        fprintf(stderr, "grab: keyboard went away\n");
+        rc = -1;
+        done = true;
+      }
+    }
+  }
+
+  close(epfd);
+  return rc;
+}
+
+void grab_close(grab_t *g) {
+  if (g->yi != NULL) {
+    youinput_forward_leds(g->yi, -1);
+    ioctl(g->evfd, EVIOCGRAB, 0);
+    close(g->evfd);
+    g->yi = NULL;
+  }
+  for (int i = 0; i < g->nhotkeys; i++) {
+    script_free(&g->hotkeys[i].script);
+  }
+}
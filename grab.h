@@ -0,0 +1,38 @@
+#ifndef YOUINPUT_GRAB_H
+#define YOUINPUT_GRAB_H
+
+#include <linux/input.h>
+#include <stdbool.h>
+
+#include "script.h"
+#include "youinput.h"
+
+#define GRAB_MAX_HOTKEYS 32
+#define GRAB_BATCH 64
+
+struct hotkey {
+  control_set_t cset;
+  int code;
+  script_t script;
+};
+
+// Grabs a physical keyboard and replays it through our uinput device, one
+// write per SYN frame, running a compiled script in place of any hotkey.
+struct grab {
+  int evfd;
+  youinput_t *yi;
+  struct hotkey hotkeys[GRAB_MAX_HOTKEYS];
+  int nhotkeys;
+  unsigned char down[(KEY_MAX + 8) / 8];
+  unsigned char swallowed[(KEY_MAX + 8) / 8];
+  bool dropping;
+};
+
+typedef struct grab grab_t;
+
+int grab_open(grab_t *grab, const char *devpath, youinput_t *yi);
+int grab_add_hotkey(grab_t *grab, const char *spec, bool use_cache);
+int grab_run(grab_t *grab, script_emit_fn emit, void *ctx);
+void grab_close(grab_t *grab);
+
+#endif
@@ -0,0 +1,32 @@
+#ifndef YOUINPUT_INTERNAL_H
+#define YOUINPUT_INTERNAL_H
+
+#include <stdbool.h>
+
+#include "youinput.h"
+
+// Shared between the library, the binary and the benchmarks but not
+// installed; none of it is exported from libyouinput.so.
+
+struct lock_state {
+  bool caps;
+  bool num;
+};
+
+typedef struct lock_state lock_state_t;
+
+control_set_t meta_codes(char **remaining);
+int parse_special_code(char *cmd);
+int parse_cmd(char *cmd, control_set_t *cset);
+void emit(int fd, int type, int code, int val);
+int emit_cmd(int fd, char *cmd);
+int emit_combo(int fd, control_set_t cset, int code);
+void read_locks(int fd, lock_state_t *locks, int led_sink);
+control_set_t compensate_locks(control_set_t cset, int code, lock_state_t locks);
+void track_locks(int code, lock_state_t *locks);
+void emit_cset(int fd, control_set_t cset, int val);
+void emit_key(int fd, int code);
+
+void gamepad_setup(int fd);
+
+#endif
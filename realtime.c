@@ -0,0 +1,74 @@
+#include <errno.h>
+#include <sched.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+
+#include "realtime.h"
+
+// How much stack to fault in before locking, comfortably more than the
+// emission path and the X calls under it use.
+#define REALTIME_STACK_PREFAULT (256 * 1024)
+
+static void prefault_stack(void) {
+  volatile unsigned char stack[REALTIME_STACK_PREFAULT];
+  for (size_t i = 0; i < sizeof(stack); i += 4096) {
+    stack[i] = 0;
+  }
+}
+
+// Each step is best effort: without the privileges for it we say so and carry
+// on with whatever did succeed rather than refusing to type.
+void realtime_enter(realtime_t *rt, int cpu, int priority) {
+  memset(rt, 0, sizeof(realtime_t));
+
+  if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+    fprintf(stderr, "realtime: mlockall: %s\n", strerror(errno));
+  } else {
+    rt->locked = true;
+    prefault_stack();
+  }
+
+  if (cpu < 0) {
+    cpu = sched_getcpu();
+  }
+  if (cpu >= 0 && sched_getaffinity(0, sizeof(cpu_set_t), &rt->old_cpus) == 0) {
+    cpu_set_t cpus;
+    CPU_ZERO(&cpus);
+    CPU_SET(cpu, &cpus);
+    if (sched_setaffinity(0, sizeof(cpu_set_t), &cpus) == -1) {
+      fprintf(stderr, "realtime: pinning to cpu %d: %s\n", cpu, strerror(errno));
+    } else {
+      rt->pinned = true;
+    }
+  }
+
+  int min = sched_get_priority_min(SCHED_FIFO);
+  int max = sched_get_priority_max(SCHED_FIFO);
+  struct sched_param param;
+  memset(&param, 0, sizeof(param));
+  param.sched_priority = priority < min ? min : priority > max ? max : priority;
+
+  rt->old_policy = sched_getscheduler(0);
+  if (rt->old_policy == -1 || sched_getparam(0, &rt->old_param) == -1) {
+    fprintf(stderr, "realtime: reading scheduler: %s\n", strerror(errno));
+  } else if (sched_setscheduler(0, SCHED_FIFO, &param) == -1) {
+    fprintf(stderr, "realtime: SCHED_FIFO priority %d: %s\n",
+            param.sched_priority, strerror(errno));
+  } else {
+    rt->scheduled = true;
+  }
+}
+
+void realtime_leave(realtime_t *rt) {
+  if (rt->scheduled) {
+    sched_setscheduler(0, rt->old_policy, &rt->old_param);
+  }
+  if (rt->pinned) {
+    sched_setaffinity(0, sizeof(cpu_set_t), &rt->old_cpus);
+  }
+  if (rt->locked) {
+    munlockall();
+  }
+  memset(rt, 0, sizeof(realtime_t));
+}
@@ -0,0 +1,24 @@
+#ifndef YOUINPUT_REALTIME_H
+#define YOUINPUT_REALTIME_H
+
+#include <sched.h>
+#include <stdbool.h>
+
+#define REALTIME_DEFAULT_PRIORITY 50
+
+// Everything realtime_enter() changed, so realtime_leave() can put it back.
+struct realtime {
+  bool locked;
+  bool pinned;
+  bool scheduled;
+  cpu_set_t old_cpus;
+  int old_policy;
+  struct sched_param old_param;
+};
+
+typedef struct realtime realtime_t;
+
+void realtime_enter(realtime_t *rt, int cpu, int priority);
+void realtime_leave(realtime_t *rt);
+
+#endif
@@ -0,0 +1,680 @@
+#include <errno.h>
+#include <libgen.h>
+#include <limits.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "internal.h"
+#include "script.h"
+
+// Script files are line based. Blank lines and lines starting with '#' are
+// ignored, as is everything from a '#' with blanks on both sides to the end of
+// the line. Everything else is a statement:
+//
+//   key <cmd>...        emit each kbd style command
+//   text <string>       type the rest of the line literally
+//   wait <ms>           sleep, ms may be a literal or $var
+//   set <var> <value>   value may be a literal or $var
+//   add <var> <n>       add a literal (possibly negative) to var
+//   loop <count>        repeat up to the matching end, count literal or $var;
+//                       a count of zero or less skips the body
+//   end
+//   label <name>
+//   goto <name>
+//   jz <var> <name>     jump if var is zero
+//   jnz <var> <name>    jump if var is not zero
+//   include <path>      compile another file in place, relative to this one
+//
+// Key commands are translated at compile time, so running a script never
+// parses kbd syntax and performs no allocations.
+
+#define SCRIPT_MAGIC "YIBC"
+#define SCRIPT_VERSION 2
+#define SCRIPT_LINE_MAX 1024
+#define SCRIPT_NAME_MAX 32
+#define SCRIPT_MAX_LABELS 256
+#define SCRIPT_MAX_FIXUPS 1024
+#define SCRIPT_MAX_LOOP_DEPTH 32
+
+#define KEY_MOD_CTRL (1 << 16)
+#define KEY_MOD_SHIFT (1 << 17)
+#define KEY_MOD_META (1 << 18)
+#define KEY_MOD_ALT (1 << 19)
+#define KEY_CODE_MASK 0xffff
+
+struct label {
+  char name[SCRIPT_NAME_MAX];
+  int pc;
+};
+
+struct fixup {
+  char name[SCRIPT_NAME_MAX];
+  int pc;
+  int line;
+  const char *path;
+};
+
+struct loop {
+  int top;
+  int exit_jump;
+  int var;
+};
+
+struct compiler {
+  script_t *script;
+  char vars[SCRIPT_MAX_VARS][SCRIPT_NAME_MAX];
+  int nvars;
+  struct label labels[SCRIPT_MAX_LABELS];
+  int nlabels;
+  struct fixup fixups[SCRIPT_MAX_FIXUPS];
+  int nfixups;
+  int depth;
+};
+
+static int compile_file(struct compiler *c, const char *path);
+
+static int32_t pack_key(control_set_t cset, int code) {
+  return (code & KEY_CODE_MASK)
+    | (cset.ctrl ? KEY_MOD_CTRL : 0)
+    | (cset.shift ? KEY_MOD_SHIFT : 0)
+    | (cset.meta ? KEY_MOD_META : 0)
+    | (cset.alt ? KEY_MOD_ALT : 0);
+}
+
+static int unpack_key(int32_t key, control_set_t *cset) {
+  cset->ctrl = key & KEY_MOD_CTRL;
+  cset->shift = key & KEY_MOD_SHIFT;
+  cset->meta = key & KEY_MOD_META;
+  cset->alt = key & KEY_MOD_ALT;
+  return key & KEY_CODE_MASK;
+}
+
+static void sleep_ms(long ms) {
+  struct timespec ts;
+  if (ms <= 0)
+    return;
+  ts.tv_sec = ms / 1000;
+  ts.tv_nsec = (ms % 1000) * 1000000L;
+  // as elsewhere, we don't need anything exact so EINTR is ignored
+  (void) nanosleep(&ts, NULL);
+}
+
+static int emit_insn(struct compiler *c, int op, int var, int src, int32_t arg) {
+  script_t *s = c->script;
+  if (s->ncode == s->cap) {
+    int cap = s->cap ? s->cap * 2 : 64;
+    struct script_insn *code = realloc(s->code, cap * sizeof(*code));
+    if (code == NULL)
+      return -1;
+    s->code = code;
+    s->cap = cap;
+  }
+  s->code[s->ncode].op = op;
+  s->code[s->ncode].var = var;
+  s->code[s->ncode].src = src;
+  s->code[s->ncode].arg = arg;
+  return s->ncode++;
+}
+
+static int lookup_var(struct compiler *c, const char *name) {
+  for (int i = 0; i < c->nvars; i++) {
+    if (strcmp(c->vars[i], name) == 0)
+      return i;
+  }
+  if (c->nvars == SCRIPT_MAX_VARS || strlen(name) >= SCRIPT_NAME_MAX)
+    return -1;
+  strcpy(c->vars[c->nvars], name);
+  return c->nvars++;
+}
+
+// Loop counters get names that can't be written in a script.
+static int hidden_var(struct compiler *c) {
+  char name[SCRIPT_NAME_MAX];
+  snprintf(name, sizeof(name), " loop%d", c->nvars);
+  return lookup_var(c, name);
+}
+
+static char *next_word(char **line) {
+  char *p = *line;
+  while (*p == ' ' || *p == '\t')
+    p++;
+  if (*p == '\0')
+    return NULL;
+  char *word = p;
+  while (*p && *p != ' ' && *p != '\t')
+    p++;
+  if (*p)
+    *p++ = '\0';
+  *line = p;
+  return word;
+}
+
+// Cuts the line at a trailing comment. A '#' ending the line or followed by
+// text is kept, so "key #" and "text issue #5" still type the hash.
+static void strip_comment(char *line) {
+  for (char *p = line; *p; p++) {
+    if ((p[0] == ' ' || p[0] == '\t') && p[1] == '#'
+        && (p[2] == ' ' || p[2] == '\t')) {
+      while (p > line && (p[-1] == ' ' || p[-1] == '\t'))
+        p--;
+      *p = '\0';
+      return;
+    }
+  }
+}
+
+static bool at_end(char **line) {
+  return next_word(line) == NULL;
+}
+
+static int parse_number(const char *word, int32_t *out) {
+  char *end;
+  errno = 0;
+  long n = strtol(word, &end, 10);
+  if (errno || *end != '\0' || n < INT32_MIN || n > INT32_MAX)
+    return -1;
+  *out = n;
+  return 0;
+}
+
+static int record_dep(struct compiler *c, const char *path) {
+  script_t *s = c->script;
+  struct stat st;
+
+  if (s->ndeps == SCRIPT_MAX_DEPS || stat(path, &st) == -1)
+    return -1;
+  s->deps[s->ndeps].path = strdup(path);
+  if (s->deps[s->ndeps].path == NULL)
+    return -1;
+  s->deps[s->ndeps].mtime_sec = st.st_mtim.tv_sec;
+  s->deps[s->ndeps].mtime_nsec = st.st_mtim.tv_nsec;
+  s->deps[s->ndeps].size = st.st_size;
+  s->ndeps++;
+  return 0;
+}
+
+static int add_label(struct compiler *c, const char *name) {
+  for (int i = 0; i < c->nlabels; i++) {
+    if (strcmp(c->labels[i].name, name) == 0)
+      return -1;
+  }
+  if (c->nlabels == SCRIPT_MAX_LABELS || strlen(name) >= SCRIPT_NAME_MAX)
+    return -1;
+  strcpy(c->labels[c->nlabels].name, name);
+  c->labels[c->nlabels].pc = c->script->ncode;
+  c->nlabels++;
+  return 0;
+}
+
+static int add_fixup(struct compiler *c, const char *name, int pc,
+                     const char *path, int line) {
+  if (c->nfixups == SCRIPT_MAX_FIXUPS || strlen(name) >= SCRIPT_NAME_MAX)
+    return -1;
+  strcpy(c->fixups[c->nfixups].name, name);
+  c->fixups[c->nfixups].pc = pc;
+  c->fixups[c->nfixups].path = path;
+  c->fixups[c->nfixups].line = line;
+  c->nfixups++;
+  return 0;
+}
+
+static int resolve_fixups(struct compiler *c) {
+  for (int i = 0; i < c->nfixups; i++) {
+    int j;
+    for (j = 0; j < c->nlabels; j++) {
+      if (strcmp(c->fixups[i].name, c->labels[j].name) == 0)
+        break;
+    }
+    if (j == c->nlabels) {
+      fprintf(stderr, "%s:%d: unknown label %s\n", c->fixups[i].path,
+              c->fixups[i].line, c->fixups[i].name);
+      return -1;
+    }
+    c->script->code[c->fixups[i].pc].arg = c->labels[j].pc;
+  }
+  return 0;
+}
+
+static int compile_key(struct compiler *c, char *cmd) {
+  control_set_t cset;
+  int code = parse_cmd(cmd, &cset);
+  if (code <= 0)
+    return -1;
+  return emit_insn(c, OP_KEY, 0, 0, pack_key(cset, code));
+}
+
+static int compile_text(struct compiler *c, const char *text) {
+  char cmd[2] = { 0, 0 };
+  for (const char *p = text; *p; p++) {
+    cmd[0] = *p;
+    if (compile_key(c, cmd) < 0)
+      return -1;
+  }
+  return 0;
+}
+
+// Compiles "literal" or "$var" into either the literal op or the variable op.
+static int compile_value(struct compiler *c, const char *word, int op_imm,
+                         int op_var, int var) {
+  int32_t n;
+  if (word[0] == '$') {
+    int src = lookup_var(c, word + 1);
+    if (src < 0)
+      return -1;
+    return emit_insn(c, op_var, var, src, 0);
+  }
+  if (parse_number(word, &n) < 0)
+    return -1;
+  return emit_insn(c, op_imm, var, 0, n);
+}
+
+static int compile_line(struct compiler *c, char *line, const char *path,
+                        int lineno, struct loop *loops, int *nloops) {
+  char *op = next_word(&line);
+  char *arg, *arg2;
+  int var;
+
+  if (op == NULL || op[0] == '#')
+    return 0;
+  strip_comment(line);
+
+  if (strcmp(op, "key") == 0) {
+    while ((arg = next_word(&line)) != NULL) {
+      if (compile_key(c, arg) < 0) {
+        fprintf(stderr, "%s:%d: cannot parse key %s\n", path, lineno, arg);
+        return -1;
+      }
+    }
+    return 0;
+  }
+
+  if (strcmp(op, "text") == 0) {
+    // next_word() consumed the one separating blank, the rest is verbatim
+    if (compile_text(c, line) < 0) {
+      fprintf(stderr, "%s:%d: cannot type text\n", path, lineno);
+      return -1;
+    }
+    return 0;
+  }
+
+  if (strcmp(op, "include") == 0) {
+    char resolved[PATH_MAX];
+    char dir[PATH_MAX];
+    arg = next_word(&line);
+    if (arg == NULL || !at_end(&line))
+      goto syntax;
+    if (arg[0] == '/') {
+      snprintf(resolved, sizeof(resolved), "%s", arg);
+    } else {
+      snprintf(dir, sizeof(dir), "%s", path);
+      snprintf(resolved, sizeof(resolved), "%s/%s", dirname(dir), arg);
+    }
+    if (c->depth >= SCRIPT_MAX_INCLUDE_DEPTH) {
+      fprintf(stderr, "%s:%d: includes nested too deeply\n", path, lineno);
+      return -1;
+    }
+    return compile_file(c, resolved);
+  }
+
+  if (strcmp(op, "wait") == 0) {
+    arg = next_word(&line);
+    if (arg == NULL || !at_end(&line)
+        || compile_value(c, arg, OP_WAIT, OP_WAITV, 0) < 0)
+      goto syntax;
+    return 0;
+  }
+
+  if (strcmp(op, "set") == 0 || strcmp(op, "add") == 0) {
+    int32_t n;
+    arg = next_word(&line);
+    arg2 = next_word(&line);
+    if (arg == NULL || arg2 == NULL || !at_end(&line)
+        || (var = lookup_var(c, arg)) < 0)
+      goto syntax;
+    if (op[0] == 's')
+      return compile_value(c, arg2, OP_SET, OP_COPY, var) < 0 ? -1 : 0;
+    if (parse_number(arg2, &n) < 0)
+      goto syntax;
+    return emit_insn(c, OP_ADD, var, 0, n) < 0 ? -1 : 0;
+  }
+
+  if (strcmp(op, "loop") == 0) {
+    int32_t n;
+    arg = next_word(&line);
+    if (arg == NULL || !at_end(&line))
+      goto syntax;
+    if (arg[0] != '$' && parse_number(arg, &n) == 0 && n < 0) {
+      fprintf(stderr, "%s:%d: negative loop count %s\n", path, lineno, arg);
+      return -1;
+    }
+    if (*nloops == SCRIPT_MAX_LOOP_DEPTH
+        || (var = hidden_var(c)) < 0
+        || compile_value(c, arg, OP_SET, OP_COPY, var) < 0)
+      goto syntax;
+    loops[*nloops].var = var;
+    loops[*nloops].top = c->script->ncode;
+    // a $var count may still be negative at run time, that runs no times
+    loops[*nloops].exit_jump = emit_insn(c, OP_JLE, var, 0, 0);
+    (*nloops)++;
+    return 0;
+  }
+
+  if (strcmp(op, "end") == 0) {
+    if (!at_end(&line))
+      goto syntax;
+    if (*nloops == 0) {
+      fprintf(stderr, "%s:%d: end without loop\n", path, lineno);
+      return -1;
+    }
+    struct loop *l = &loops[--(*nloops)];
+    if (emit_insn(c, OP_ADD, l->var, 0, -1) < 0
+        || emit_insn(c, OP_JMP, 0, 0, l->top) < 0)
+      return -1;
+    c->script->code[l->exit_jump].arg = c->script->ncode;
+    return 0;
+  }
+
+  if (strcmp(op, "label") == 0) {
+    arg = next_word(&line);
+    if (arg == NULL || !at_end(&line) || add_label(c, arg) < 0) {
+      fprintf(stderr, "%s:%d: bad or duplicate label\n", path, lineno);
+      return -1;
+    }
+    return 0;
+  }
+
+  if (strcmp(op, "goto") == 0) {
+    arg = next_word(&line);
+    if (arg == NULL || !at_end(&line))
+      goto syntax;
+    int pc = emit_insn(c, OP_JMP, 0, 0, 0);
+    return pc < 0 ? -1 : add_fixup(c, arg, pc, path, lineno);
+  }
+
+  if (strcmp(op, "jz") == 0 || strcmp(op, "jnz") == 0) {
+    arg = next_word(&line);
+    arg2 = next_word(&line);
+    if (arg == NULL || arg2 == NULL || !at_end(&line)
+        || (var = lookup_var(c, arg)) < 0)
+      goto syntax;
+    int pc = emit_insn(c, op[1] == 'z' ? OP_JZ : OP_JNZ, var, 0, 0);
+    return pc < 0 ? -1 : add_fixup(c, arg2, pc, path, lineno);
+  }
+
+  fprintf(stderr, "%s:%d: unknown statement %s\n", path, lineno, op);
+  return -1;
+
+syntax:
+  fprintf(stderr, "%s:%d: malformed %s\n", path, lineno, op);
+  return -1;
+}
+
+static int compile_file(struct compiler *c, const char *path) {
+  char line[SCRIPT_LINE_MAX];
+  struct loop loops[SCRIPT_MAX_LOOP_DEPTH];
+  int nloops = 0;
+  int lineno = 0;
+  int rc = 0;
+
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return -1;
+  }
+  if (record_dep(c, path) < 0) {
+    fprintf(stderr, "%s: too many included files\n", path);
+    fclose(f);
+    return -1;
+  }
+  // fixups keep a pointer to the path for error messages
+  path = c->script->deps[c->script->ndeps - 1].path;
+
+  c->depth++;
+  while (rc == 0 && fgets(line, sizeof(line), f) != NULL) {
+    size_t len = strlen(line);
+    lineno++;
+    if (len > 0 && line[len - 1] == '\n') {
+      line[--len] = '\0';
+    } else if (!feof(f)) {
+      fprintf(stderr, "%s:%d: line too long\n", path, lineno);
+      rc = -1;
+      break;
+    }
+    rc = compile_line(c, line, path, lineno, loops, &nloops);
+  }
+  c->depth--;
+
+  if (rc == 0 && nloops > 0) {
+    fprintf(stderr, "%s: loop without end\n", path);
+    rc = -1;
+  }
+
+  fclose(f);
+  return rc;
+}
+
+static void cache_path(char *buf, size_t len, const char *path) {
+  snprintf(buf, len, "%s%s", path, SCRIPT_CACHE_SUFFIX);
+}
+
+static bool deps_fresh(const script_t *s) {
+  struct stat st;
+  for (int i = 0; i < s->ndeps; i++) {
+    if (stat(s->deps[i].path, &st) == -1
+        || st.st_mtim.tv_sec != s->deps[i].mtime_sec
+        || st.st_mtim.tv_nsec != s->deps[i].mtime_nsec
+        || st.st_size != s->deps[i].size)
+      return false;
+  }
+  return true;
+}
+
+// A cache file is trusted only as far as the interpreter can't be sent out of
+// bounds by it.
+static bool code_valid(const script_t *s) {
+  if (s->ncode == 0 || s->code[s->ncode - 1].op != OP_HALT)
+    return false;
+  for (int i = 0; i < s->ncode; i++) {
+    const struct script_insn *insn = &s->code[i];
+    if (insn->op > OP_JLE || insn->src >= SCRIPT_MAX_VARS)
+      return false;
+    if ((insn->op == OP_JMP || insn->op == OP_JZ || insn->op == OP_JNZ
+         || insn->op == OP_JLE)
+        && (insn->arg < 0 || insn->arg >= s->ncode))
+      return false;
+  }
+  return true;
+}
+
+// Cache layout, host endian: magic, version, ndeps, ncode, then per dep its
+// mtime, size and length prefixed path, then the instructions.
+static int read_cache(script_t *s, const char *path) {
+  char cpath[PATH_MAX];
+  char magic[4];
+  uint32_t version, ndeps, ncode;
+
+  cache_path(cpath, sizeof(cpath), path);
+  FILE *f = fopen(cpath, "rb");
+  if (f == NULL)
+    return -1;
+
+  if (fread(magic, sizeof(magic), 1, f) != 1
+      || memcmp(magic, SCRIPT_MAGIC, sizeof(magic)) != 0
+      || fread(&version, sizeof(version), 1, f) != 1
+      || version != SCRIPT_VERSION
+      || fread(&ndeps, sizeof(ndeps), 1, f) != 1
+      || fread(&ncode, sizeof(ncode), 1, f) != 1
+      || ndeps == 0 || ndeps > SCRIPT_MAX_DEPS)
+    goto fail;
+
+  for (uint32_t i = 0; i < ndeps; i++) {
+    struct script_dep *dep = &s->deps[i];
+    uint32_t len;
+    if (fread(&dep->mtime_sec, sizeof(dep->mtime_sec), 1, f) != 1
+        || fread(&dep->mtime_nsec, sizeof(dep->mtime_nsec), 1, f) != 1
+        || fread(&dep->size, sizeof(dep->size), 1, f) != 1
+        || fread(&len, sizeof(len), 1, f) != 1
+        || len >= PATH_MAX
+        || (dep->path = calloc(1, len + 1)) == NULL)
+      goto fail;
+    s->ndeps++;
+    if (fread(dep->path, 1, len, f) != len)
+      goto fail;
+  }
+
+  // the cache must belong to this script, not just any file of that name
+  if (strcmp(s->deps[0].path, path) != 0 || !deps_fresh(s))
+    goto fail;
+
+  s->code = calloc(ncode, sizeof(struct script_insn));
+  if (s->code == NULL
+      || fread(s->code, sizeof(struct script_insn), ncode, f) != ncode)
+    goto fail;
+  s->ncode = s->cap = ncode;
+  if (!code_valid(s))
+    goto fail;
+
+  fclose(f);
+  return 0;
+
+fail:
+  fclose(f);
+  script_free(s);
+  return -1;
+}
+
+static void write_cache(const script_t *s, const char *path) {
+  char cpath[PATH_MAX];
+  char tmp[PATH_MAX + 32];
+  uint32_t version = SCRIPT_VERSION;
+  uint32_t ndeps = s->ndeps;
+  uint32_t ncode = s->ncode;
+  bool ok;
+
+  cache_path(cpath, sizeof(cpath), path);
+  snprintf(tmp, sizeof(tmp), "%s.%d", cpath, (int) getpid());
+  FILE *f = fopen(tmp, "wb");
+  if (f == NULL)
+    return;
+
+  ok = fwrite(SCRIPT_MAGIC, 4, 1, f) == 1
+    && fwrite(&version, sizeof(version), 1, f) == 1
+    && fwrite(&ndeps, sizeof(ndeps), 1, f) == 1
+    && fwrite(&ncode, sizeof(ncode), 1, f) == 1;
+  for (int i = 0; ok && i < s->ndeps; i++) {
+    const struct script_dep *dep = &s->deps[i];
+    uint32_t len = strlen(dep->path);
+    ok = fwrite(&dep->mtime_sec, sizeof(dep->mtime_sec), 1, f) == 1
+      && fwrite(&dep->mtime_nsec, sizeof(dep->mtime_nsec), 1, f) == 1
+      && fwrite(&dep->size, sizeof(dep->size), 1, f) == 1
+      && fwrite(&len, sizeof(len), 1, f) == 1
+      && fwrite(dep->path, 1, len, f) == len;
+  }
+  ok = ok && fwrite(s->code, sizeof(struct script_insn), ncode, f) == ncode;
+
+  // a missing or stale cache only costs a recompile, so failures are quiet
+  if (fclose(f) != 0 || !ok || rename(tmp, cpath) == -1)
+    unlink(tmp);
+}
+
+int script_load(script_t *script, const char *path, bool use_cache) {
+  struct compiler *c;
+  int rc;
+
+  memset(script, 0, sizeof(script_t));
+  if (use_cache && read_cache(script, path) == 0)
+    return 0;
+
+  // the label and fixup tables are too big for the stack
+  c = calloc(1, sizeof(struct compiler));
+  if (c == NULL)
+    return -1;
+  c->script = script;
+
+  rc = compile_file(c, path);
+  if (rc == 0)
+    rc = resolve_fixups(c);
+  if (rc == 0 && emit_insn(c, OP_HALT, 0, 0, 0) < 0)
+    rc = -1;
+  free(c);
+
+  if (rc < 0) {
+    script_free(script);
+    return -1;
+  }
+
+  if (use_cache)
+    write_cache(script, path);
+
+  return 0;
+}
+
+int script_run(const script_t *script, script_emit_fn emit, void *ctx) {
+  int32_t vars[SCRIPT_MAX_VARS];
+  control_set_t cset;
+  int presses = 0;
+  int pc = 0;
+
+  memset(vars, 0, sizeof(vars));
+  for (;;) {
+    const struct script_insn *insn = &script->code[pc++];
+    switch (insn->op) {
+      case OP_HALT:
+        return presses;
+      case OP_KEY: {
+        int code = unpack_key(insn->arg, &cset);
+        int n = emit(ctx, cset, code);
+        if (n < 0)
+          return -1;
+        presses += n;
+        break;
+      }
+      case OP_WAIT:
+        sleep_ms(insn->arg);
+        break;
+      case OP_WAITV:
+        sleep_ms(vars[insn->src]);
+        break;
+      case OP_SET:
+        vars[insn->var] = insn->arg;
+        break;
+      case OP_COPY:
+        vars[insn->var] = vars[insn->src];
+        break;
+      case OP_ADD:
+        // wraps rather than overflowing, scripts may count however they like
+        vars[insn->var] = (uint32_t) vars[insn->var] + (uint32_t) insn->arg;
+        break;
+      case OP_JMP:
+        pc = insn->arg;
+        break;
+      case OP_JZ:
+        if (vars[insn->var] == 0)
+          pc = insn->arg;
+        break;
+      case OP_JNZ:
+        if (vars[insn->var] != 0)
+          pc = insn->arg;
+        break;
+      case OP_JLE:
+        if (vars[insn->var] <= 0)
+          pc = insn->arg;
+        break;
+      default:
+        fprintf(stderr, "script: bad instruction %d at %d\n", insn->op, pc - 1);
+        return -1;
+    }
+  }
+}
+
+void script_free(script_t *script) {
+  free(script->code);
+  for (int i = 0; i < script->ndeps; i++) {
+    free(script->deps[i].path);
+  }
+  memset(script, 0, sizeof(script_t));
+}
@@ -0,0 +1,62 @@
+#ifndef YOUINPUT_SCRIPT_H
+#define YOUINPUT_SCRIPT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "youinput.h"
+
+#define SCRIPT_MAX_VARS 256
+#define SCRIPT_MAX_DEPS 32
+#define SCRIPT_MAX_INCLUDE_DEPTH 8
+// The compiled form of foo.yi is cached next to it as foo.yic.
+#define SCRIPT_CACHE_SUFFIX "c"
+
+enum script_op {
+  OP_HALT,
+  OP_KEY,   /* emit the packed key in arg */
+  OP_WAIT,  /* sleep arg milliseconds */
+  OP_WAITV, /* sleep vars[var] milliseconds */
+  OP_SET,   /* vars[var] = arg */
+  OP_COPY,  /* vars[var] = vars[src] */
+  OP_ADD,   /* vars[var] += arg */
+  OP_JMP,   /* pc = arg */
+  OP_JZ,    /* if vars[var] == 0, pc = arg */
+  OP_JNZ,   /* if vars[var] != 0, pc = arg */
+  OP_JLE,   /* if vars[var] <= 0, pc = arg */
+};
+
+// Fixed 8 byte layout, written to the cache as is.
+struct script_insn {
+  uint8_t op;
+  uint8_t var;
+  uint16_t src;
+  int32_t arg;
+};
+
+struct script_dep {
+  char *path;
+  int64_t mtime_sec;
+  int64_t mtime_nsec;
+  int64_t size;
+};
+
+struct script {
+  struct script_insn *code;
+  int ncode;
+  int cap;
+  struct script_dep deps[SCRIPT_MAX_DEPS];
+  int ndeps;
+};
+
+typedef struct script script_t;
+
+// Called by script_run() for every key; returns the number of key presses it
+// emitted, or -1 to abandon the rest of the script.
+typedef int (*script_emit_fn)(void *ctx, control_set_t cset, int code);
+
+int script_load(script_t *script, const char *path, bool use_cache);
+int script_run(const script_t *script, script_emit_fn emit, void *ctx);
+void script_free(script_t *script);
+
+#endif
@@ -0,0 +1,56 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "stop.h"
+
+static volatile sig_atomic_t stopping = 0;
+static int pipe_fds[2] = { -1, -1 };
+static stop_fn volatile notify_fn = NULL;
+static void *volatile notify_ctx = NULL;
+
+static void on_signal(int sig) {
+  int saved = errno;
+  (void) sig;
+  stopping = 1;
+  (void) write(pipe_fds[1], "", 1);
+  if (notify_fn != NULL)
+    notify_fn(notify_ctx);
+  errno = saved;
+}
+
+int stop_init(void) {
+  struct sigaction sa;
+
+  if (pipe_fds[0] != -1)
+    return 0;
+  if (pipe2(pipe_fds, O_NONBLOCK | O_CLOEXEC) == -1) {
+    fprintf(stderr, "stop: %s\n", strerror(errno));
+    return -1;
+  }
+
+  // no SA_RESTART, blocking waits should return so callers look again
+  memset(&sa, 0, sizeof(sa));
+  sa.sa_handler = on_signal;
+  sigaction(SIGINT, &sa, NULL);
+  sigaction(SIGTERM, &sa, NULL);
+  return 0;
+}
+
+int stop_fd(void) {
+  return pipe_fds[0];
+}
+
+bool stop_requested(void) {
+  return stopping;
+}
+
+void stop_notify(stop_fn fn, void *ctx) {
+  // the handler must never see a new fn with the old ctx
+  notify_fn = NULL;
+  notify_ctx = ctx;
+  notify_fn = fn;
+}
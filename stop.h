@@ -0,0 +1,18 @@
+#ifndef YOUINPUT_STOP_H
+#define YOUINPUT_STOP_H
+
+#include <stdbool.h>
+
+// SIGINT/SIGTERM handling shared by the modes that run until killed. The
+// handlers are installed once by stop_init(). A stop is sticky: stop_fd()
+// stays readable from then on, so a signal that arrives while a loop is busy
+// wakes its next poll instead of being lost.
+typedef void (*stop_fn)(void *ctx);
+
+int stop_init(void);
+int stop_fd(void);
+bool stop_requested(void);
+// fn is called from the signal handler and must be async-signal-safe.
+void stop_notify(stop_fn fn, void *ctx);
+
+#endif
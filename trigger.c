@@ -0,0 +1,166 @@
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "stop.h"
+#include "trigger.h"
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+int trigger_init(trigger_t *t, int fd) {
+  struct epoll_event ev;
+
+  memset(t, 0, sizeof(trigger_t));
+  t->fd = fd;
+  t->keepalive_fd = -1;
+  t->stopfd = -1;
+  t->min_ns = UINT64_MAX;
+
+  t->epfd = epoll_create1(EPOLL_CLOEXEC);
+  if (t->epfd == -1)
+    return -1;
+
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = fd;
+  if (epoll_ctl(t->epfd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+    close(t->epfd);
+    t->epfd = -1;
+    return -1;
+  }
+  return 0;
+}
+
+int trigger_open(trigger_t *t, const char *path) {
+  if (mkfifo(path, 0600) == -1 && errno != EEXIST) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return -1;
+  }
+
+  int fd = open(path, O_RDONLY | O_NONBLOCK | O_CLOEXEC);
+  if (fd == -1) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return -1;
+  }
+
+  // Holding a write end ourselves means the FIFO never reports EOF/HUP when a
+  // writer goes away, so epoll only wakes us for actual data.
+  int keepalive = open(path, O_WRONLY | O_NONBLOCK | O_CLOEXEC);
+  if (keepalive == -1 || trigger_init(t, fd) == -1) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    if (keepalive != -1)
+      close(keepalive);
+    close(fd);
+    return -1;
+  }
+  t->keepalive_fd = keepalive;
+  return 0;
+}
+
+// Splits what has been read so far into lines, keeping any partial line at
+// the front of the buffer for the next read.
+static void dispatch_lines(trigger_t *t, trigger_line_fn fn, void *ctx) {
+  char *start = t->buf;
+  char *end = t->buf + t->len;
+  char *nl;
+
+  while ((nl = memchr(start, '\n', end - start)) != NULL) {
+    *nl = '\0';
+    if (!t->discarding)
+      fn(ctx, start);
+    t->discarding = false;
+    start = nl + 1;
+  }
+
+  t->len = end - start;
+  if (t->len == (int) sizeof(t->buf)) {
+    fprintf(stderr, "trigger: dropping line longer than %d bytes\n",
+            TRIGGER_LINE_MAX);
+    t->discarding = true;
+    t->len = 0;
+  } else if (start != t->buf) {
+    memmove(t->buf, start, t->len);
+  }
+}
+
+// Handles one wakeup. Returns 1 if lines were processed, 0 on timeout and
+// -1 on error or when a stop signal arrived.
+int trigger_poll(trigger_t *t, trigger_line_fn fn, void *ctx, int timeout_ms) {
+  struct epoll_event events[2];
+  ssize_t n;
+
+  int rc = epoll_wait(t->epfd, events, 2, timeout_ms);
+  if (rc == 0 || (rc == -1 && errno == EINTR))
+    return 0;
+  if (rc == -1)
+    return -1;
+  for (int i = 0; i < rc; i++) {
+    if (events[i].data.fd == t->stopfd) {
+      t->stopped = true;
+      return -1;
+    }
+  }
+
+  uint64_t woke = now_ns();
+  uint64_t lines = t->lines;
+  while ((n = read(t->fd, t->buf + t->len, sizeof(t->buf) - t->len)) > 0) {
+    t->len += n;
+    for (char *p = t->buf + t->len - n; p < t->buf + t->len; p++) {
+      if (*p == '\n')
+        t->lines++;
+    }
+    dispatch_lines(t, fn, ctx);
+  }
+  if (n == 0 && t->keepalive_fd == -1)
+    return -1; /* plain pipe, every writer has gone */
+
+  if (t->lines != lines) {
+    uint64_t took = now_ns() - woke;
+    t->wakeups++;
+    t->total_ns += took;
+    if (took < t->min_ns)
+      t->min_ns = took;
+    if (took > t->max_ns)
+      t->max_ns = took;
+  }
+  return 1;
+}
+
+// Runs until SIGINT/SIGTERM or an error. The stop fd is in the epoll set, so
+// a signal arriving while a line is being typed is still seen by the next
+// epoll_wait() instead of being lost.
+int trigger_run(trigger_t *t, trigger_line_fn fn, void *ctx) {
+  struct epoll_event ev;
+  int rc;
+
+  if (stop_init() < 0)
+    return -1;
+  memset(&ev, 0, sizeof(ev));
+  ev.events = EPOLLIN;
+  ev.data.fd = stop_fd();
+  if (epoll_ctl(t->epfd, EPOLL_CTL_ADD, stop_fd(), &ev) == -1)
+    return -1;
+  t->stopfd = stop_fd();
+
+  while ((rc = trigger_poll(t, fn, ctx, -1)) >= 0)
+    ;
+  return t->stopped ? 0 : rc;
+}
+
+void trigger_close(trigger_t *t) {
+  if (t->epfd != -1)
+    close(t->epfd);
+  if (t->keepalive_fd != -1)
+    close(t->keepalive_fd);
+  close(t->fd);
+}
@@ -0,0 +1,39 @@
+#ifndef YOUINPUT_TRIGGER_H
+#define YOUINPUT_TRIGGER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#define TRIGGER_LINE_MAX 4096
+
+// Trigger mode reads newline terminated lines from a pipe or FIFO and hands
+// each one over as soon as it arrives. Latency is measured per wakeup, from
+// epoll returning to the handler returning for the last line read.
+struct trigger {
+  int fd;
+  int keepalive_fd;
+  int epfd;
+  int stopfd;
+  bool stopped;
+  char buf[TRIGGER_LINE_MAX];
+  int len;
+  bool discarding;
+  uint64_t lines;
+  uint64_t wakeups;
+  uint64_t min_ns;
+  uint64_t max_ns;
+  uint64_t total_ns;
+};
+
+typedef struct trigger trigger_t;
+
+// Called with each line, newline stripped. The line may be modified.
+typedef void (*trigger_line_fn)(void *ctx, char *line);
+
+int trigger_open(trigger_t *trigger, const char *path);
+int trigger_init(trigger_t *trigger, int fd);
+int trigger_poll(trigger_t *trigger, trigger_line_fn fn, void *ctx, int timeout_ms);
+int trigger_run(trigger_t *trigger, trigger_line_fn fn, void *ctx);
+void trigger_close(trigger_t *trigger);
+
+#endif
@@ -0,0 +1,45 @@
+#ifndef YOUINPUT_H
+#define YOUINPUT_H
+
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Everything else in libyouinput.so is built with -fvisibility=hidden.
+#define YOUINPUT_API __attribute__((visibility("default")))
+
+struct control_set {
+  bool ctrl;
+  bool shift;
+  bool meta;
+  bool alt;
+};
+
+typedef struct control_set control_set_t;
+
+// Embedding API, see device.c. Each handle owns its own uinput device and
+// shares no state with other handles.
+#define YOUINPUT_WAIT_X11 (1 << 0)
+// Create a gamepad instead of a keyboard, see gamepad.h.
+#define YOUINPUT_GAMEPAD (1 << 1)
+
+typedef struct youinput youinput_t;
+
+YOUINPUT_API youinput_t *youinput_open(int flags);
+YOUINPUT_API int youinput_fd(const youinput_t *yi);
+YOUINPUT_API const char *youinput_name(const youinput_t *yi);
+YOUINPUT_API int youinput_emit(youinput_t *yi, control_set_t cset, int code);
+YOUINPUT_API void youinput_forward_leds(youinput_t *yi, int evfd);
+YOUINPUT_API void youinput_poll_leds(youinput_t *yi);
+YOUINPUT_API int youinput_send(youinput_t *yi, const char *cmd);
+YOUINPUT_API int youinput_send_seq(youinput_t *yi, const char *seq);
+YOUINPUT_API int youinput_send_text(youinput_t *yi, const char *text);
+YOUINPUT_API void youinput_close(youinput_t *yi);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif